@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <variant>
+
+
+namespace Http
+{
+
+//! Immutable buffer shared by many responses (e.g. cached content).
+using SharedBuffer = std::shared_ptr<const std::string>;
+
+/**
+ * \brief Owned file descriptor, closed on destruction.
+ */
+class FileDescriptor final
+{
+public:
+	explicit FileDescriptor(int fd) noexcept;
+
+	FileDescriptor(const FileDescriptor&) = delete;
+	FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+	FileDescriptor(FileDescriptor&&) = delete;
+	FileDescriptor& operator=(FileDescriptor&&) = delete;
+
+	/**
+	 * \brief Return file descriptor.
+	 */
+	[[nodiscard]] int Get() const noexcept;
+
+	~FileDescriptor();
+
+private:
+	//! File descriptor.
+	const int fd_ = -1;
+};
+
+/**
+ * \brief Part of opened file, sent without copying into user space where possible.
+ */
+struct FileRegion final
+{
+	//! Opened file, may be shared by many responses.
+	std::shared_ptr<const FileDescriptor> file;
+	//! Offset of region in file.
+	uint64_t offset = 0;
+	//! Region size.
+	uint64_t size = 0;
+};
+
+/**
+ * \brief Body produced by parts while it is sent.
+ */
+struct BodyGenerator final
+{
+	//! Return next part of body, nullopt after last part.
+	std::function<std::optional<std::string>()> generate;
+	//! Body size if it is known.
+	std::optional<uint64_t> size;
+};
+
+//! Response body: owned string, shared buffer, file region or generator.
+using HttpBody = std::variant<std::string, SharedBuffer, FileRegion, BodyGenerator>;
+
+/**
+ * \brief Return body size, nullopt if it is unknown (generator without size).
+ */
+std::optional<uint64_t> GetBodySize(const HttpBody& body) noexcept;
+
+} // namespace Http
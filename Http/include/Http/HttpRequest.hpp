@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Http/Types.hpp>
+#include <Http/Uri.hpp>
 
 #include <string>
 #include <unordered_map>
@@ -31,6 +32,10 @@ public:
 	 * \brief Return uri.
 	 */
 	[[nodiscard]] const std::string& GetURI() const noexcept;
+	/**
+	 * \brief Return uri split into path, query and fragment (valid while request isn't changed).
+	 */
+	[[nodiscard]] UriView GetUriView() const noexcept;
 	/**
 	 * \brief Return http version.
 	 */
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <Http/HttpBody.hpp>
 #include <Http/Types.hpp>
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <optional>
 
@@ -40,13 +42,23 @@ public:
 	 */
 	[[nodiscard]] const HeadersMap& GetHeaders() const noexcept;
 	/**
-	 * \brief Return http body.
+	 * \brief Return in-memory http body (owned or shared), empty for file and generated bodies.
 	 */
 	[[nodiscard]] const std::string& GetBody() const noexcept;
 	/**
-	 * \brief Pack http response to string.
+	 * \brief Return http body of any kind.
+	 */
+	[[nodiscard]] const HttpBody& GetHttpBody() const noexcept;
+	/**
+	 * \brief Pack http response to string (file is read, generator is called until end of body).
 	 */
 	[[nodiscard]] std::string PackToString() const;
+	/**
+	 * \brief Pack status line and headers (without body) to string.
+	 *
+	 * \param[in] extra_headers Formatted header lines added after own headers, each line ends with CRLF.
+	 */
+	[[nodiscard]] std::string PackHeadersToString(std::string_view extra_headers = {}) const;
 	/**
 	 * \brief Pack http response to string.
 	 */
@@ -55,10 +67,36 @@ public:
 	 * \brief Set header key value.
 	 */
 	HttpResponse& SetHeader(const std::string& key, std::string value);
+	/**
+	 * \brief Remove header.
+	 */
+	HttpResponse& RemoveHeader(const std::string& key);
 	/**
 	 * \brief Set body.
 	 */
 	void SetBody(std::string body);
+	/**
+	 * \brief Set shared immutable body, it isn't copied while response is sent.
+	 */
+	void SetSharedBody(SharedBuffer body);
+	/**
+	 * \brief Set body from file region.
+	 */
+	void SetFileBody(FileRegion body);
+	/**
+	 * \brief Set body produced while response is sent (chunked if size is unknown).
+	 */
+	void SetGeneratedBody(BodyGenerator body);
+
+private:
+	/**
+	 * \brief Pack status line and headers, buffer has room for body of body_size bytes.
+	 */
+	[[nodiscard]] std::string PackHeaders(std::string_view extra_headers, size_t body_size) const;
+	/**
+	 * \brief Set Content-Length header by body size.
+	 */
+	void UpdateContentLength();
 
 private:
 	//! Http status code.
@@ -70,7 +108,7 @@ private:
 	//! Http headers.
 	HeadersMap headers_;
 	//! Http body.
-	std::string body_;
+	HttpBody body_;
 };
 
 /**
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <ctime>
 #include <string>
 #include <string_view>
 #include <unordered_map>
@@ -43,6 +45,7 @@ enum class StatusCode : unsigned
 	Unauthorized = 401,
 	Forbidden = 403,
 	NotFound = 404,
+	MethodNotAllowed = 405,
 	InternalServerError = 500,
 	NotImplemented = 501,
 	BadGateway = 502,
@@ -50,6 +53,44 @@ enum class StatusCode : unsigned
 	Unknown = 10000
 };
 
+/**
+ * \brief Supported content codings.
+ */
+enum class ContentEncoding : unsigned
+{
+	Identity,
+	Gzip,
+	Deflate,
+	Brotli,
+	Zstd,
+	Count
+};
+
+/**
+ * \brief Parsed Accept-Encoding header (quality value per content coding).
+ */
+class AcceptEncoding final
+{
+public:
+	/**
+	 * \brief Parse Accept-Encoding header value.
+	 */
+	explicit AcceptEncoding(std::string_view header = {});
+
+	/**
+	 * \brief Return quality (0 - 1000) for content coding, 0 means not acceptable.
+	 */
+	[[nodiscard]] unsigned GetQuality(ContentEncoding encoding) const noexcept;
+	/**
+	 * \brief Check if content coding is acceptable.
+	 */
+	[[nodiscard]] bool Accepts(ContentEncoding encoding) const noexcept;
+
+private:
+	//! Quality value for every content coding.
+	std::array<unsigned, static_cast<size_t>(ContentEncoding::Count)> quality_{};
+};
+
 /**
  * \brief Http version.
  */
@@ -110,6 +151,11 @@ std::string ConvertToString(StatusCode status_code);
  */
 std::string ConvertToString(HttpMethodType method) noexcept;
 
+/**
+ * \brief Return content coding token (e.g. "gzip", "br").
+ */
+std::string_view ConvertToString(ContentEncoding encoding) noexcept;
+
 /**
  * \brief Return http method by string representation.
  */
@@ -125,4 +171,29 @@ StatusCode GetStatusCodeFromString(const std::string& status_code_str);
  */
 StatusCode GetStatusCodeFromUnsigned(const unsigned status_code);
 
+/**
+ * \brief Format time as http date (IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT").
+ */
+std::string FormatHttpDate(std::time_t time);
+
+/**
+ * \brief Parse http date (IMF-fixdate), return nullopt if date is incorrect.
+ */
+std::optional<std::time_t> ParseHttpDate(const std::string& date);
+
+/**
+ * \brief Check if comma separated header value (e.g. "Connection") contains token, ignore case.
+ */
+bool ContainsToken(std::string_view value, std::string_view token) noexcept;
+
+/**
+ * \brief Check if If-None-Match value ("*" or entity tags list) matches entity tag by weak comparison.
+ */
+bool MatchEntityTag(std::string_view if_none_match, std::string_view etag) noexcept;
+
+/**
+ * \brief Check if response with status code may have body (not 1xx, 204 and 304).
+ */
+bool StatusCodeAllowsBody(StatusCode status_code) noexcept;
+
 } // namespace Http
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace Http
+{
+
+/**
+ * \brief Query parameter, key and value are views into uri (not decoded).
+ */
+struct QueryParameter final
+{
+	std::string_view key;
+	std::string_view value;
+};
+
+/**
+ * \brief Query parameters list, first parameters are stored without heap allocation.
+ */
+class QueryParameters final
+{
+public:
+	/**
+	 * \brief Add parameter.
+	 */
+	void Add(QueryParameter parameter);
+	/**
+	 * \brief Return parameters count.
+	 */
+	[[nodiscard]] size_t Size() const noexcept;
+	/**
+	 * \brief Return parameter by index.
+	 */
+	[[nodiscard]] const QueryParameter& operator[](size_t index) const noexcept;
+	/**
+	 * \brief Return raw value of first parameter with key.
+	 */
+	[[nodiscard]] std::optional<std::string_view> Find(std::string_view key) const noexcept;
+
+private:
+	//! Parameters count stored inline.
+	static constexpr size_t inline_size_ = 8;
+
+	//! First parameters.
+	std::array<QueryParameter, inline_size_> inline_parameters_;
+	//! Rest parameters.
+	std::vector<QueryParameter> overflow_parameters_;
+	//! Parameters count.
+	size_t size_ = 0;
+};
+
+/**
+ * \brief Request target split into path, query and fragment (views into source string).
+ */
+class UriView final
+{
+public:
+	explicit UriView(std::string_view uri) noexcept;
+
+	/**
+	 * \brief Return raw path ("/a/b" for "/a/b?c=d#e").
+	 */
+	[[nodiscard]] std::string_view GetPath() const noexcept;
+	/**
+	 * \brief Return raw query without '?' ("c=d" for "/a/b?c=d#e").
+	 */
+	[[nodiscard]] std::string_view GetQuery() const noexcept;
+	/**
+	 * \brief Return raw fragment without '#' ("e" for "/a/b?c=d#e").
+	 */
+	[[nodiscard]] std::string_view GetFragment() const noexcept;
+	/**
+	 * \brief Return query parameters, query is parsed on first call.
+	 */
+	[[nodiscard]] const QueryParameters& GetQueryParameters() const;
+	/**
+	 * \brief Return decoded value of first query parameter with key.
+	 */
+	[[nodiscard]] std::optional<std::string> GetQueryParameter(std::string_view key) const;
+
+private:
+	//! Path.
+	std::string_view path_;
+	//! Query.
+	std::string_view query_;
+	//! Fragment.
+	std::string_view fragment_;
+	//! Lazily parsed query.
+	mutable std::optional<QueryParameters> query_parameters_;
+};
+
+/**
+ * \brief Percent-decode value and append it to output.
+ *
+ * \param[in] value Encoded value.
+ * \param[out] output Decoded value.
+ * \param[in] plus_as_space Decode '+' as space (form encoded query).
+ *
+ * \return False if value contains incorrect escape.
+ */
+[[nodiscard]] bool PercentDecode(std::string_view value, std::string& output, bool plus_as_space = false);
+
+/**
+ * \brief Percent-decode value, return nullopt if value contains incorrect escape.
+ */
+[[nodiscard]] std::optional<std::string> PercentDecode(std::string_view value, bool plus_as_space = false);
+
+} // namespace Http
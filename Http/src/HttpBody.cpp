@@ -0,0 +1,44 @@
+#include <Http/HttpBody.hpp>
+
+#include <unistd.h>
+
+
+namespace Http
+{
+
+FileDescriptor::FileDescriptor(const int fd) noexcept
+	: fd_(fd)
+{
+}
+
+int FileDescriptor::Get() const noexcept
+{
+	return fd_;
+}
+
+FileDescriptor::~FileDescriptor()
+{
+	if (fd_ >= 0)
+	{
+		::close(fd_);
+	}
+}
+
+std::optional<uint64_t> GetBodySize(const HttpBody& body) noexcept
+{
+	if (const auto* string = std::get_if<std::string>(&body))
+	{
+		return string->size();
+	}
+	if (const auto* buffer = std::get_if<SharedBuffer>(&body))
+	{
+		return *buffer ? (*buffer)->size() : 0;
+	}
+	if (const auto* region = std::get_if<FileRegion>(&body))
+	{
+		return region->size;
+	}
+	return std::get<BodyGenerator>(body).size;
+}
+
+} // namespace Http
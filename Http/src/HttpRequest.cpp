@@ -14,10 +14,15 @@ namespace
 constexpr const char* name_value_separator = ": ";
 constexpr const char* crlf = "\r\n";
 
-bool IsKeepAliveConnection(const std::string& value)
+// HTTP/1.1 connections are persistent unless "close" is sent, HTTP/1.0 ones only with "keep-alive" (RFC 7230 6.3).
+bool IsKeepAliveConnection(const HttpVersion& version, const std::string& value)
 {
-	const ICStringEqual comp;
-	return comp(value, "kepp-alive");
+	if (ContainsToken(value, "close"))
+	{
+		return false;
+	}
+	const auto persistent_by_default = version.major > 1 || (version.major == 1 && version.minor >= 1);
+	return persistent_by_default || ContainsToken(value, "keep-alive");
 }
 
 } // namespace
@@ -41,10 +46,7 @@ HttpRequest::HttpRequest(
 	SetBody(std::move(body));
 
 	const auto header_it = headers_.find("Connection");
-	if (header_it != headers_.cend())
-	{
-		keep_alive_ = IsKeepAliveConnection(header_it->second);
-	}
+	keep_alive_ = IsKeepAliveConnection(version_, header_it != headers_.cend() ? header_it->second : std::string{});
 }
 
 HttpMethodType HttpRequest::GetMethodType() const noexcept
@@ -57,6 +59,11 @@ const std::string& HttpRequest::GetURI() const noexcept
 	return uri_;
 }
 
+UriView HttpRequest::GetUriView() const noexcept
+{
+	return UriView{uri_};
+}
+
 const HttpVersion& HttpRequest::GetHTTPVersion() const noexcept
 {
 	return version_;
@@ -120,7 +127,7 @@ HttpRequest& HttpRequest::SetHeader(const std::string& key, std::string value)
 		const ICStringEqual comp;
 		if (comp(key, "Connection"))
 		{
-			keep_alive_ = IsKeepAliveConnection(value);
+			keep_alive_ = IsKeepAliveConnection(version_, value);
 		}
 	}
 	std::swap(headers_[key], value);
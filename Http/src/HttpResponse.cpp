@@ -1,5 +1,9 @@
 #include <Http/HttpResponse.hpp>
 
+#include <unistd.h>
+
+#include <cerrno>
+#include <stdexcept>
 #include <utility>
 #include <string>
 
@@ -50,14 +54,72 @@ const HeadersMap& HttpResponse::GetHeaders() const noexcept
 }
 
 const std::string& HttpResponse::GetBody() const noexcept
+{
+	static const std::string empty_body;
+	if (const auto* body = std::get_if<std::string>(&body_))
+	{
+		return *body;
+	}
+	const auto* shared_body = std::get_if<SharedBuffer>(&body_);
+	return shared_body && *shared_body ? **shared_body : empty_body;
+}
+
+const HttpBody& HttpResponse::GetHttpBody() const noexcept
 {
 	return body_;
 }
 
 std::string HttpResponse::PackToString() const
+{
+	// Only owned body is copied as is, other bodies aren't reserved for.
+	const auto* owned_body = std::get_if<std::string>(&body_);
+	auto buffer = PackHeaders({}, owned_body ? owned_body->size() : 0);
+	if (const auto* region = std::get_if<FileRegion>(&body_))
+	{
+		const auto start = buffer.size();
+		buffer.resize(start + region->size);
+		uint64_t offset = 0;
+		while (offset < region->size)
+		{
+			const auto bytes_read = ::pread(
+				region->file->Get(),
+				buffer.data() + start + offset,
+				region->size - offset,
+				static_cast<off_t>(region->offset + offset));
+			if (bytes_read < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (bytes_read <= 0)
+			{
+				throw std::runtime_error("Can't read response body from file");
+			}
+			offset += static_cast<uint64_t>(bytes_read);
+		}
+	}
+	else if (const auto* generator = std::get_if<BodyGenerator>(&body_))
+	{
+		for (auto part = generator->generate(); part; part = generator->generate())
+		{
+			buffer += *part;
+		}
+	}
+	else
+	{
+		buffer += GetBody();
+	}
+	return buffer;
+}
+
+std::string HttpResponse::PackHeadersToString(const std::string_view extra_headers) const
+{
+	return PackHeaders(extra_headers, 0);
+}
+
+std::string HttpResponse::PackHeaders(const std::string_view extra_headers, const size_t body_size) const
 {
 	std::string buffer;
-	buffer.reserve(8192 + 16 + status_text_.size() + body_.size());
+	buffer.reserve(8192 + 16 + status_text_.size() + extra_headers.size() + body_size);
 	buffer += ConvertToString(version_) + " ";
 	buffer += ConvertToString(status_code_) + " ";
 	buffer += status_text_;
@@ -69,8 +131,8 @@ std::string HttpResponse::PackToString() const
 		buffer += value;
 		buffer += crlf;
 	}
+	buffer += extra_headers;
 	buffer += crlf;
-	buffer += body_;
 	return buffer;
 }
 
@@ -85,16 +147,55 @@ HttpResponse& HttpResponse::SetHeader(const std::string& key, std::string value)
 	return *this;
 }
 
+HttpResponse& HttpResponse::RemoveHeader(const std::string& key)
+{
+	headers_.erase(key);
+	return *this;
+}
+
 void HttpResponse::SetBody(std::string body)
 {
-	std::swap(body, body_);
-	if (body_.empty())
+	body_ = std::move(body);
+	UpdateContentLength();
+}
+
+void HttpResponse::SetSharedBody(SharedBuffer body)
+{
+	body_ = std::move(body);
+	UpdateContentLength();
+}
+
+void HttpResponse::SetFileBody(FileRegion body)
+{
+	if (!body.file)
+	{
+		throw std::runtime_error("File of response body isn't set");
+	}
+	body_ = std::move(body);
+	UpdateContentLength();
+}
+
+void HttpResponse::SetGeneratedBody(BodyGenerator body)
+{
+	if (!body.generate)
+	{
+		throw std::runtime_error("Generator of response body isn't set");
+	}
+	body_ = std::move(body);
+	UpdateContentLength();
+}
+
+void HttpResponse::UpdateContentLength()
+{
+	const auto size = GetBodySize(body_);
+	// Empty body still needs length, otherwise persistent connection client waits for connection close.
+	if (!size || (*size == 0 && !StatusCodeAllowsBody(status_code_)))
 	{
 		headers_.erase("Content-Length");
 	}
 	else
 	{
-		SetHeader("Content-Length", std::to_string(body_.size()));
+		SetHeader("Content-Length", std::to_string(*size));
 	}
 }
 
@@ -1,6 +1,9 @@
 #include <Http/Types.hpp>
 
 #include <algorithm>
+#include <array>
+#include <cctype>
+#include <ctime>
 
 
 namespace Http
@@ -36,8 +39,138 @@ size_t GetMaxHttpMethodSizeImpl()
 	return max_size;
 }
 
+std::string_view TrimSpaces(std::string_view value) noexcept
+{
+	while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+	{
+		value.remove_prefix(1);
+	}
+	while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+	{
+		value.remove_suffix(1);
+	}
+	return value;
+}
+
+bool EqualIgnoreCase(const std::string_view value1, const std::string_view value2) noexcept
+{
+	return value1.size() == value2.size() && std::equal(
+		value1.cbegin(),
+		value1.cend(),
+		value2.cbegin(),
+		[](const auto ch1, const auto ch2) { return std::tolower(ch1) == std::tolower(ch2); });
+}
+
+// Parse qvalue ("0", "0.5", "1.000"), return value multiplied by 1000.
+std::optional<unsigned> ParseQuality(const std::string_view value) noexcept
+{
+	if (value.empty() || (value.front() != '0' && value.front() != '1'))
+	{
+		return std::nullopt;
+	}
+
+	unsigned quality = (value.front() - '0') * 1000;
+	if (value.size() == 1)
+	{
+		return quality;
+	}
+	if (value[1] != '.' || value.size() > 5)
+	{
+		return std::nullopt;
+	}
+
+	unsigned multiplier = 100;
+	for (size_t i = 2; i < value.size(); ++i, multiplier /= 10)
+	{
+		if (!std::isdigit(value[i]))
+		{
+			return std::nullopt;
+		}
+		quality += (value[i] - '0') * multiplier;
+	}
+	return quality <= 1000 ? std::optional<unsigned>{quality} : std::nullopt;
+}
+
 } // namespace
 
+AcceptEncoding::AcceptEncoding(std::string_view header)
+{
+	constexpr auto identity_index = static_cast<size_t>(ContentEncoding::Identity);
+	constexpr unsigned not_set = 1001;
+
+	std::array<unsigned, static_cast<size_t>(ContentEncoding::Count)> quality;
+	quality.fill(not_set);
+	unsigned wildcard_quality = not_set;
+
+	while (!header.empty())
+	{
+		const auto separator = header.find(',');
+		auto item = TrimSpaces(header.substr(0, separator));
+		header.remove_prefix(separator == std::string_view::npos ? header.size() : separator + 1);
+
+		unsigned item_quality = 1000;
+		const auto parameters_pos = item.find(';');
+		if (parameters_pos != std::string_view::npos)
+		{
+			auto parameter = TrimSpaces(item.substr(parameters_pos + 1));
+			item = TrimSpaces(item.substr(0, parameters_pos));
+			if (parameter.size() < 2 || std::tolower(parameter[0]) != 'q' || parameter[1] != '=')
+			{
+				continue;
+			}
+			const auto parsed_quality = ParseQuality(TrimSpaces(parameter.substr(2)));
+			if (!parsed_quality)
+			{
+				continue;
+			}
+			item_quality = *parsed_quality;
+		}
+
+		if (item == "*")
+		{
+			wildcard_quality = item_quality;
+			continue;
+		}
+		for (size_t i = 0; i < quality.size(); ++i)
+		{
+			const auto encoding = static_cast<ContentEncoding>(i);
+			if (EqualIgnoreCase(item, ConvertToString(encoding))
+				|| (encoding == ContentEncoding::Gzip && EqualIgnoreCase(item, "x-gzip")))
+			{
+				quality[i] = item_quality;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < quality.size(); ++i)
+	{
+		if (quality[i] != not_set)
+		{
+			quality_[i] = quality[i];
+		}
+		else if (wildcard_quality != not_set)
+		{
+			quality_[i] = wildcard_quality;
+		}
+		else
+		{
+			// Identity is always acceptable, unless it is excluded explicitly (RFC 7231 5.3.4).
+			quality_[i] = i == identity_index ? 1 : 0;
+		}
+	}
+}
+
+unsigned AcceptEncoding::GetQuality(const ContentEncoding encoding) const noexcept
+{
+	const auto index = static_cast<size_t>(encoding);
+	return index < quality_.size() ? quality_[index] : 0;
+}
+
+bool AcceptEncoding::Accepts(const ContentEncoding encoding) const noexcept
+{
+	return GetQuality(encoding) != 0;
+}
+
 size_t ICStringHash::operator()(const std::string& key) const
 {
 	std::string converted_key_;
@@ -84,6 +217,7 @@ std::string GetDefaultStatusText(const StatusCode status_code)
 		{StatusCode::Unauthorized, "Unauthorized"},
 		{StatusCode::Forbidden, "Forbidden"},
 		{StatusCode::NotFound, "Not Found"},
+		{StatusCode::MethodNotAllowed, "Method Not Allowed"},
 		{StatusCode::InternalServerError, "Internal Server Error"},
 		{StatusCode::NotImplemented, "Not Implemented"},
 		{StatusCode::BadGateway, "Bad Gateway"},
@@ -177,6 +311,13 @@ std::string GetDefaultHtmlText(const StatusCode status_code)
 			"<body><h1>404 Not Found</h1></body>"
 			"</html>"
 		},
+		{
+			StatusCode::MethodNotAllowed,
+			"<html>"
+			"<head><title>Method Not Allowed</title></head>"
+			"<body><h1>405 Method Not Allowed</h1></body>"
+			"</html>"
+		},
 		{
 			StatusCode::InternalServerError,
 			"<html>"
@@ -241,6 +382,20 @@ std::string ConvertToString(const HttpMethodType method) noexcept
 	return it != methods.cend() ? std::string{it->first} : "Unknown";
 }
 
+std::string_view ConvertToString(const ContentEncoding encoding) noexcept
+{
+	switch (encoding)
+	{
+	case ContentEncoding::Identity: return "identity";
+	case ContentEncoding::Gzip: return "gzip";
+	case ContentEncoding::Deflate: return "deflate";
+	case ContentEncoding::Brotli: return "br";
+	case ContentEncoding::Zstd: return "zstd";
+	default: return "identity";
+	}
+	return "identity";
+}
+
 HttpMethodType GetHttpMethodTypeFromString(const std::string_view str)
 {
 	const auto& methods = GetAllowedMethodsNotation();
@@ -263,6 +418,7 @@ StatusCode GetStatusCodeFromString(const std::string& status_code_str)
 		{ConvertToString(StatusCode::Unauthorized), StatusCode::Unauthorized},
 		{ConvertToString(StatusCode::Forbidden), StatusCode::Forbidden},
 		{ConvertToString(StatusCode::NotFound), StatusCode::NotFound},
+		{ConvertToString(StatusCode::MethodNotAllowed), StatusCode::MethodNotAllowed},
 		{ConvertToString(StatusCode::InternalServerError), StatusCode::InternalServerError},
 		{ConvertToString(StatusCode::NotImplemented), StatusCode::NotImplemented},
 		{ConvertToString(StatusCode::BadGateway), StatusCode::BadGateway},
@@ -287,6 +443,7 @@ StatusCode GetStatusCodeFromUnsigned(const unsigned status_code)
 		{static_cast<unsigned>(StatusCode::Unauthorized), StatusCode::Unauthorized},
 		{static_cast<unsigned>(StatusCode::Forbidden), StatusCode::Forbidden},
 		{static_cast<unsigned>(StatusCode::NotFound), StatusCode::NotFound},
+		{static_cast<unsigned>(StatusCode::MethodNotAllowed), StatusCode::MethodNotAllowed},
 		{static_cast<unsigned>(StatusCode::InternalServerError), StatusCode::InternalServerError},
 		{static_cast<unsigned>(StatusCode::NotImplemented), StatusCode::NotImplemented},
 		{static_cast<unsigned>(StatusCode::BadGateway), StatusCode::BadGateway},
@@ -296,4 +453,68 @@ StatusCode GetStatusCodeFromUnsigned(const unsigned status_code)
 	return it != statuses.cend() ? it->second : StatusCode::Unknown;
 }
 
+std::string FormatHttpDate(const std::time_t time)
+{
+	std::tm tm{};
+	if (gmtime_r(&time, &tm) == nullptr)
+	{
+		return {};
+	}
+
+	std::array<char, 64> buffer;
+	const auto size = std::strftime(buffer.data(), buffer.size(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+	return std::string{buffer.data(), size};
+}
+
+std::optional<std::time_t> ParseHttpDate(const std::string& date)
+{
+	std::tm tm{};
+	const char* end = strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+	if (end == nullptr || *end != '\0')
+	{
+		return std::nullopt;
+	}
+	return timegm(&tm);
+}
+
+bool ContainsToken(std::string_view value, const std::string_view token) noexcept
+{
+	while (!value.empty())
+	{
+		const auto separator = value.find(',');
+		if (EqualIgnoreCase(TrimSpaces(value.substr(0, separator)), token))
+		{
+			return true;
+		}
+		value.remove_prefix(separator == std::string_view::npos ? value.size() : separator + 1);
+	}
+	return false;
+}
+
+bool MatchEntityTag(std::string_view if_none_match, const std::string_view etag) noexcept
+{
+	// Weak comparison is used for If-None-Match (RFC 7232 3.2).
+	while (!if_none_match.empty())
+	{
+		const auto separator = if_none_match.find(',');
+		auto tag = TrimSpaces(if_none_match.substr(0, separator));
+		if (tag.substr(0, 2) == "W/")
+		{
+			tag.remove_prefix(2);
+		}
+		if (tag == "*" || tag == etag)
+		{
+			return true;
+		}
+		if_none_match.remove_prefix(separator == std::string_view::npos ? if_none_match.size() : separator + 1);
+	}
+	return false;
+}
+
+bool StatusCodeAllowsBody(const StatusCode status_code) noexcept
+{
+	const auto code = static_cast<unsigned>(status_code);
+	return code >= 200 && status_code != StatusCode::NoContent && status_code != StatusCode::NotModified;
+}
+
 } // namespace Http
@@ -0,0 +1,199 @@
+#include <Http/Uri.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+
+namespace Http
+{
+
+namespace
+{
+
+constexpr int8_t not_hex = -1;
+
+constexpr std::array<int8_t, 256> MakeHexTable() noexcept
+{
+	std::array<int8_t, 256> table{};
+	for (auto& value : table)
+	{
+		value = not_hex;
+	}
+	for (int i = 0; i < 10; ++i)
+	{
+		table['0' + i] = static_cast<int8_t>(i);
+	}
+	for (int i = 0; i < 6; ++i)
+	{
+		table['a' + i] = static_cast<int8_t>(10 + i);
+		table['A' + i] = static_cast<int8_t>(10 + i);
+	}
+	return table;
+}
+
+//! Hex digit value by char.
+constexpr auto hex_table = MakeHexTable();
+
+} // namespace
+
+void QueryParameters::Add(const QueryParameter parameter)
+{
+	if (size_ < inline_size_)
+	{
+		inline_parameters_[size_] = parameter;
+	}
+	else
+	{
+		overflow_parameters_.push_back(parameter);
+	}
+	++size_;
+}
+
+size_t QueryParameters::Size() const noexcept
+{
+	return size_;
+}
+
+const QueryParameter& QueryParameters::operator[](const size_t index) const noexcept
+{
+	return index < inline_size_ ? inline_parameters_[index] : overflow_parameters_[index - inline_size_];
+}
+
+std::optional<std::string_view> QueryParameters::Find(const std::string_view key) const noexcept
+{
+	for (size_t i = 0; i < size_; ++i)
+	{
+		const auto& parameter = (*this)[i];
+		if (parameter.key == key)
+		{
+			return parameter.value;
+		}
+	}
+	return std::nullopt;
+}
+
+UriView::UriView(std::string_view uri) noexcept
+{
+	const auto fragment_pos = uri.find('#');
+	if (fragment_pos != std::string_view::npos)
+	{
+		fragment_ = uri.substr(fragment_pos + 1);
+		uri = uri.substr(0, fragment_pos);
+	}
+
+	const auto query_pos = uri.find('?');
+	if (query_pos != std::string_view::npos)
+	{
+		query_ = uri.substr(query_pos + 1);
+		uri = uri.substr(0, query_pos);
+	}
+	path_ = uri;
+}
+
+std::string_view UriView::GetPath() const noexcept
+{
+	return path_;
+}
+
+std::string_view UriView::GetQuery() const noexcept
+{
+	return query_;
+}
+
+std::string_view UriView::GetFragment() const noexcept
+{
+	return fragment_;
+}
+
+const QueryParameters& UriView::GetQueryParameters() const
+{
+	if (query_parameters_)
+	{
+		return *query_parameters_;
+	}
+
+	auto& parameters = query_parameters_.emplace();
+	auto query = query_;
+	while (!query.empty())
+	{
+		const auto separator = query.find('&');
+		const auto item = query.substr(0, separator);
+		query.remove_prefix(separator == std::string_view::npos ? query.size() : separator + 1);
+		if (item.empty())
+		{
+			continue;
+		}
+
+		const auto equal_pos = item.find('=');
+		if (equal_pos == std::string_view::npos)
+		{
+			parameters.Add(QueryParameter{item, {}});
+		}
+		else
+		{
+			parameters.Add(QueryParameter{item.substr(0, equal_pos), item.substr(equal_pos + 1)});
+		}
+	}
+	return parameters;
+}
+
+std::optional<std::string> UriView::GetQueryParameter(const std::string_view key) const
+{
+	const auto value = GetQueryParameters().Find(key);
+	if (!value)
+	{
+		return std::nullopt;
+	}
+	return PercentDecode(*value, true);
+}
+
+bool PercentDecode(std::string_view value, std::string& output, const bool plus_as_space)
+{
+	output.reserve(output.size() + value.size());
+	while (!value.empty())
+	{
+		// Copy run without escapes at once, memchr is vectorized.
+		const auto* escape = static_cast<const char*>(std::memchr(value.data(), '%', value.size()));
+		const auto run_size = escape ? static_cast<size_t>(escape - value.data()) : value.size();
+		const auto run_start = output.size();
+		output.append(value.data(), run_size);
+		if (plus_as_space)
+		{
+			std::replace(output.begin() + run_start, output.end(), '+', ' ');
+		}
+		value.remove_prefix(run_size);
+
+		if (value.empty())
+		{
+			break;
+		}
+		if (value.size() < 3)
+		{
+			return false;
+		}
+
+		const auto high = hex_table[static_cast<unsigned char>(value[1])];
+		const auto low = hex_table[static_cast<unsigned char>(value[2])];
+		if (high == not_hex || low == not_hex)
+		{
+			return false;
+		}
+		output += static_cast<char>((high << 4) | low);
+		value.remove_prefix(3);
+	}
+	return true;
+}
+
+std::optional<std::string> PercentDecode(const std::string_view value, const bool plus_as_space)
+{
+	std::string result;
+	if (!PercentDecode(value, result, plus_as_space))
+	{
+		return std::nullopt;
+	}
+	return result;
+}
+
+} // namespace Http
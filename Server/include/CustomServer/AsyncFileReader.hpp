@@ -0,0 +1,67 @@
+#pragma once
+
+#include <boost/asio.hpp>
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>
+
+
+namespace Http::Server
+{
+
+/**
+ * \brief Reads files asynchronously via io_uring (boost asio random_access_file).
+ *
+ * Owns separate io_context with one thread, which only submits reads and dispatches completions,
+ * so it never blocks on disk. Available only if server was built with HTTP_SERVER_USE_IO_URING.
+ */
+class AsyncFileReader final
+{
+public:
+	using ReadHandler = std::function<void(const boost::system::error_code&, std::string)>;
+
+	/**
+	 * \brief Check if asynchronous file io is available in this build.
+	 */
+	[[nodiscard]] static bool IsSupported() noexcept;
+
+public:
+	AsyncFileReader(const AsyncFileReader&) = delete;
+	AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+	AsyncFileReader(AsyncFileReader&&) = delete;
+	AsyncFileReader& operator=(AsyncFileReader&&) = delete;
+
+	/**
+	 * \brief Create reader, throws if asynchronous file io isn't supported.
+	 */
+	AsyncFileReader();
+
+	/**
+	 * \brief Read whole file, handler is called in reader thread.
+	 *
+	 * \param[in] fd Opened file descriptor, reader takes ownership.
+	 * \param[in] size File size (from metadata).
+	 * \param[in] handler Read completion handler.
+	 */
+	void AsyncReadFile(int fd, size_t size, ReadHandler handler);
+
+	/**
+	 * \brief Stop reader thread.
+	 */
+	void Stop();
+
+	~AsyncFileReader();
+
+private:
+	//! Files io context.
+	boost::asio::io_context io_context_;
+	//! Keep io context running without pending reads.
+	std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work_;
+	//! Thread runs io context.
+	std::thread work_thread_;
+};
+
+} // namespace Http::Server
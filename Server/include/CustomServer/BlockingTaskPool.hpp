@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace Http::Server
+{
+
+/**
+ * \brief Blocking task pool statistics.
+ */
+struct BlockingTaskPoolStatistics final
+{
+	//! Tasks waiting in queue.
+	size_t queue_size = 0;
+	//! Max tasks waiting in queue.
+	size_t max_queue_size = 0;
+	//! Completed tasks count.
+	uint64_t completed_tasks = 0;
+	//! Rejected tasks count (queue was full).
+	uint64_t rejected_tasks = 0;
+	//! Tasks dropped from queue by stop.
+	uint64_t discarded_tasks = 0;
+	//! Summary time started tasks spent in queue.
+	std::chrono::microseconds total_wait_time{0};
+	//! Average time task spent in queue.
+	std::chrono::microseconds average_wait_time{0};
+	//! Max time task spent in queue.
+	std::chrono::microseconds max_wait_time{0};
+};
+
+/**
+ * \brief Bounded thread pool for blocking work (file system calls, disk reads).
+ *
+ * Keeps network threads free from slow disk operations. Task should post its result back
+ * into connection executor.
+ */
+class BlockingTaskPool final
+{
+public:
+	BlockingTaskPool(const BlockingTaskPool&) = delete;
+	BlockingTaskPool& operator=(const BlockingTaskPool&) = delete;
+
+	BlockingTaskPool(BlockingTaskPool&&) = delete;
+	BlockingTaskPool& operator=(BlockingTaskPool&&) = delete;
+
+	BlockingTaskPool(size_t thread_count, size_t max_queue_size);
+
+	/**
+	 * \brief Add task into queue.
+	 *
+	 * \return True if task was added, false if queue is full or pool was stopped.
+	 */
+	[[nodiscard]] bool Post(std::function<void()> task);
+
+	/**
+	 * \brief Return pool statistics.
+	 */
+	[[nodiscard]] BlockingTaskPoolStatistics GetStatistics() const;
+
+	/**
+	 * \brief Stop pool, not started tasks are dropped (they are counted and logged).
+	 */
+	void Stop();
+
+	~BlockingTaskPool();
+
+private:
+	/**
+	 * \brief Queued task.
+	 */
+	struct Task final
+	{
+		//! Task function.
+		std::function<void()> function;
+		//! Time point when task was added.
+		std::chrono::steady_clock::time_point queued_at;
+	};
+
+	/**
+	 * \brief Work thread loop.
+	 */
+	void WorkLoop();
+
+private:
+	//! Max tasks waiting in queue.
+	const size_t max_queue_size_ = 0;
+	//! Protect queue.
+	mutable std::mutex mutex_;
+	//! Notify work threads about new tasks.
+	std::condition_variable condition_;
+	//! Tasks queue.
+	std::deque<Task> queue_;
+	//! Pool was stopped.
+	bool stopped_ = false;
+	//! Completed tasks count.
+	std::atomic_uint64_t completed_tasks_ = 0;
+	//! Rejected tasks count.
+	std::atomic_uint64_t rejected_tasks_ = 0;
+	//! Tasks dropped by stop.
+	std::atomic_uint64_t discarded_tasks_ = 0;
+	//! Summary time tasks spent in queue (micros).
+	std::atomic_uint64_t summary_wait_time_ = 0;
+	//! Max time task spent in queue (micros).
+	std::atomic_uint64_t max_wait_time_ = 0;
+	//! Work threads.
+	std::vector<std::thread> work_threads_;
+};
+
+} // namespace Http::Server
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Http/Types.hpp>
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+
+namespace Http::Server
+{
+
+/**
+ * \brief Streaming body compressor (gzip, deflate and zstd if server was built with it).
+ */
+class CompressionStream final
+{
+public:
+	/**
+	 * \brief Check if content coding can be produced.
+	 */
+	[[nodiscard]] static bool IsSupported(ContentEncoding encoding) noexcept;
+
+public:
+	CompressionStream(const CompressionStream&) = delete;
+	CompressionStream& operator=(const CompressionStream&) = delete;
+
+	CompressionStream(CompressionStream&&) noexcept;
+	CompressionStream& operator=(CompressionStream&&) noexcept;
+
+	/**
+	 * \brief Create compressor, throws if content coding isn't supported.
+	 */
+	CompressionStream(ContentEncoding encoding, int level);
+
+	/**
+	 * \brief Compress input and append produced bytes to output.
+	 *
+	 * Input is processed with bounded output chunks, so big bodies may be passed piece by piece.
+	 */
+	void Write(std::string_view input, std::string& output);
+
+	/**
+	 * \brief Flush compressor and append rest of compressed data to output.
+	 */
+	void Finish(std::string& output);
+
+	/**
+	 * \brief Return content coding.
+	 */
+	[[nodiscard]] ContentEncoding GetEncoding() const noexcept;
+
+	~CompressionStream();
+
+	/**
+	 * \brief Compression library backend.
+	 */
+	class Impl;
+
+private:
+	//! Content coding.
+	ContentEncoding encoding_ = ContentEncoding::Identity;
+	//! Compression library state.
+	std::unique_ptr<Impl> impl_;
+};
+
+} // namespace Http::Server
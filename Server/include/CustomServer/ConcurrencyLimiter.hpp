@@ -0,0 +1,178 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+
+
+namespace Http::Server
+{
+
+/**
+ * \brief Adaptive concurrency limit settings.
+ */
+struct ConcurrencyLimiterOptions final
+{
+	//! Limit on start.
+	unsigned initial_limit = 64;
+	//! Min limit.
+	unsigned min_limit = 8;
+	//! Max limit.
+	unsigned max_limit = 4096;
+	//! Part of new limit estimation applied on each update (0 - 1).
+	double smoothing = 0.2;
+	//! Short latency may exceed long latency this times before limit is decreased.
+	double tolerance = 1.5;
+	//! Long latency is averaged over this count of windows.
+	unsigned long_window = 20;
+	//! Min duration of latency sample window.
+	std::chrono::milliseconds window{100};
+	//! Min samples count in window.
+	unsigned min_window_samples = 10;
+	//! Max requests waiting for free slot (0 - requests above limit are rejected).
+	size_t max_queue_size = 256;
+	//! Max wait time of queued request, it is rejected after it.
+	std::chrono::milliseconds max_wait{50};
+};
+
+/**
+ * \brief Gradient concurrency limiter (like Netflix concurrency-limits Gradient2).
+ *
+ * Compares short term latency with long term one: while latency doesn't grow limit increases by sqrt(limit),
+ * when requests start to wait for resources limit decreases proportionally to latency growth.
+ * Server stays near throughput knee without manual limit tuning.
+ */
+class ConcurrencyLimiter final
+{
+public:
+	using Clock = std::chrono::steady_clock;
+	//! Called for queued request with true if it is admitted, false if it is rejected.
+	using WaitHandler = std::function<void(bool admitted)>;
+
+	/**
+	 * \brief Admission result.
+	 */
+	enum class Admission
+	{
+		//! Request may be handled.
+		Admitted,
+		//! Request waits for free slot, wait handler will be called.
+		Queued,
+		//! Request should be rejected.
+		Rejected,
+	};
+
+	ConcurrencyLimiter(const ConcurrencyLimiter&) = delete;
+	ConcurrencyLimiter& operator=(const ConcurrencyLimiter&) = delete;
+
+	ConcurrencyLimiter(ConcurrencyLimiter&&) = delete;
+	ConcurrencyLimiter& operator=(ConcurrencyLimiter&&) = delete;
+
+	explicit ConcurrencyLimiter(const ConcurrencyLimiterOptions& options = {});
+
+	/**
+	 * \brief Acquire slot for request.
+	 *
+	 * \param[in] handler Called (from thread releasing slot or expiring waiters) if request is queued.
+	 */
+	[[nodiscard]] Admission Acquire(WaitHandler handler);
+
+	/**
+	 * \brief Release slot of handled request.
+	 *
+	 * \param[in] latency Request latency, nullopt if request was dropped (it isn't a sample).
+	 */
+	void Release(std::optional<Clock::duration> latency);
+
+	/**
+	 * \brief Reject queued requests, which wait longer than max wait (waiters are also admitted if limit allows).
+	 *
+	 * Should be called after max wait of queued request, otherwise it is rejected only on next release.
+	 */
+	void ExpireWaiters();
+
+	/**
+	 * \brief Return current limit.
+	 */
+	[[nodiscard]] unsigned GetLimit() const noexcept;
+
+	/**
+	 * \brief Return requests in flight.
+	 */
+	[[nodiscard]] unsigned GetInFlight() const noexcept;
+
+	/**
+	 * \brief Return count of rejected requests.
+	 */
+	[[nodiscard]] uint64_t RejectedCount() const noexcept;
+
+	/**
+	 * \brief Return max wait time of queued request.
+	 */
+	[[nodiscard]] std::chrono::milliseconds GetMaxWait() const noexcept;
+
+private:
+	/**
+	 * \brief Take slot if there is free one.
+	 */
+	[[nodiscard]] bool TryTakeSlot() noexcept;
+
+	/**
+	 * \brief Reject expired waiters and admit waiters while there are free slots.
+	 */
+	void ProcessWaiters(Clock::time_point now);
+
+	/**
+	 * \brief Add latency sample, update limit at end of window (samples mutex is locked).
+	 */
+	void AddSample(Clock::duration latency, Clock::time_point now);
+
+	/**
+	 * \brief Queued request.
+	 */
+	struct Waiter final
+	{
+		//! Wait handler.
+		WaitHandler handler;
+		//! Time when request was queued.
+		Clock::time_point enqueued;
+	};
+
+private:
+	//! Settings.
+	const ConcurrencyLimiterOptions options_;
+	//! Current limit.
+	std::atomic_uint limit_;
+	//! Requests in flight.
+	std::atomic_uint in_flight_ = 0;
+	//! Queued requests count (waiters_ size).
+	std::atomic_size_t waiters_count_ = 0;
+	//! Rejected requests.
+	std::atomic_uint64_t rejected_ = 0;
+
+	//! Protect waiters.
+	std::mutex waiters_mutex_;
+	//! Queued requests.
+	std::deque<Waiter> waiters_;
+
+	//! Protect latency statistics.
+	std::mutex samples_mutex_;
+	//! Limit with fractional part.
+	double estimated_limit_ = 0;
+	//! Long term latency (ns).
+	double long_latency_ = 0;
+	//! Latency sum of current window (ns).
+	double window_latency_sum_ = 0;
+	//! Samples in current window.
+	unsigned window_samples_ = 0;
+	//! Max requests in flight during current window.
+	unsigned window_max_in_flight_ = 0;
+	//! Start of current window.
+	Clock::time_point window_start_;
+};
+
+} // namespace Http::Server
@@ -1,15 +1,23 @@
 #pragma once
 
+#include <CustomServer/HttpRequestConnection.hpp>
 #include <CustomServer/RequestParser.hpp>
+#include <CustomServer/ResponseStream.hpp>
+
+#include <Http/HttpBody.hpp>
 
 #include <boost/asio.hpp>
 
 #include <atomic>
 #include <array>
+#include <deque>
 #include <optional>
 #include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
 
 
 namespace Http::Server
@@ -17,8 +25,45 @@ namespace Http::Server
 
 class State;
 
-class HttpRequestConnection;
-using HttpRequestConnectionUPtr = std::unique_ptr<HttpRequestConnection>;
+/**
+ * \brief Persistent connection settings.
+ */
+struct ConnectionOptions final
+{
+	//! Max idle time while waiting for request, 0 disables timeout.
+	std::chrono::seconds timeout{60};
+	//! Max requests per connection, 0 means unlimited.
+	size_t max_requests = 1000;
+	//! Queued output bytes when write queue becomes full (reading of next request is paused).
+	size_t write_high_watermark = 1024 * 1024;
+	//! Queued output bytes when full write queue becomes available again.
+	size_t write_low_watermark = 256 * 1024;
+	//! Max time to finish started requests on shutdown, connections are dropped after it.
+	std::chrono::seconds drain_timeout{30};
+	//! Path answered by connection with server metrics in Prometheus text format, empty disables it.
+	//! Scrapes bypass admission control, so metrics are available under overload.
+	std::string metrics_path;
+	//! Set TCP_QUICKACK after every read (set by server from ListenerOptions::quick_ack).
+	bool quick_ack = false;
+	//! Tracer of sampled requests, it should outlive server (nullptr disables tracing).
+	Tracer* tracer = nullptr;
+};
+
+/**
+ * \brief What connection does after buffer is written.
+ */
+enum class WriteCompletion
+{
+	//! Response isn't finished, more buffers follow.
+	None,
+	//! Response is finished, read next request.
+	KeepAlive,
+	//! Response is finished, close connection.
+	Close,
+};
+
+//! Data to write: owned buffer, shared buffer (isn't copied) or file region (sent by sendfile).
+using OutputData = std::variant<std::string, SharedBuffer, FileRegion>;
 
 /**
  * \brief Http connection.
@@ -29,8 +74,9 @@ public:
 	[[nodiscard]] static std::shared_ptr<Connection> CreateHttpConnection(
 		State& server_state,
 		boost::asio::io_context& io_context,
-		std::function<void(HttpRequestConnectionUPtr)> request_handler,
-		std::chrono::seconds timeout = std::chrono::seconds{60});
+		RequestHandlerRef request_handler,
+		const ConnectionOptions& options = {},
+		std::atomic_uint* executor_connections = nullptr);
 
 public:
 	Connection(const Connection&) = delete;
@@ -55,24 +101,91 @@ public:
 	[[nodiscard]] bool ConnectionIsAvailable() const;
 
 	/**
-	 * \brief Send data into buffer.
+	 * \brief Add data to write queue, data is written in order of adding.
+	 *
+	 * \param[in] data Data to send.
+	 * \param[in] completion Is response finished and should connection be kept alive after it.
+	 * \param[in] handler Called when buffer is written (not called if false is returned).
 	 *
-	 * \param[in] buffer Buffer to send.
-	 * \param[in] keep_alive Close connection or not after all data is sended.
+	 * \return True if can send data (request is being answered), false otherwise.
+	 */
+	[[nodiscard]] bool Write(OutputData data, WriteCompletion completion, WriteHandler handler = {});
+
+	/**
+	 * \brief Send response to request, add connection management headers.
+	 *
+	 * Connection is kept alive if request and response allow it and requests limit isn't reached.
+	 * Generated body isn't supported (it is sent by ResponseStream).
 	 *
 	 * \return True if can send data, false otherwise.
 	 */
-	[[nodiscard]] bool Write(std::string buffer, const bool keep_alive = false);
+	[[nodiscard]] bool Write(const HttpRequest& request, const HttpResponse& response);
+
+	/**
+	 * \brief Pack status line and headers of response to request, add connection management headers.
+	 *
+	 * \param[in] request Request.
+	 * \param[in] response Response.
+	 * \param[out] keep_alive Keep connection alive after response.
+	 */
+	[[nodiscard]] std::string PackResponseHead(
+		const HttpRequest& request,
+		const HttpResponse& response,
+		bool& keep_alive) const;
+
+	/**
+	 * \brief Return bytes queued for writing.
+	 */
+	[[nodiscard]] size_t GetQueuedBytes() const noexcept;
+
+	/**
+	 * \brief Check if write queue is over high watermark (until it is drained to low watermark).
+	 *
+	 * Producers of long responses should wait before adding more data.
+	 */
+	[[nodiscard]] bool IsWriteQueueFull() const noexcept;
+
+	/**
+	 * \brief Execute task in connection context (sequentially with connection io operations).
+	 */
+	void Post(std::function<void()> task);
+
+	/**
+	 * \brief Close connection when server is stopped: idle connection is closed immediately,
+	 * otherwise after response to started request.
+	 */
+	void Drain();
 
 	~Connection();
 
 private:
+	friend struct HttpRequestConnectionDeleter;
+
+	//! Max bytes sent by one sendfile call.
+	static constexpr uint64_t max_sendfile_size = 1024 * 1024;
+
+	/**
+	 * \brief Buffer waiting for writing and action after it.
+	 */
+	struct OutputBuffer final
+	{
+		OutputData data;
+		WriteCompletion completion = WriteCompletion::None;
+		WriteHandler handler;
+		//! Last buffer of response to admitted request, request leaves requests in flight after it (overload response wasn't admitted).
+		bool finishes_request = false;
+		//! Response phases, size and span are set only for last buffer of response (next request may be started before it is written).
+		RequestTimeline timeline;
+		uint64_t response_bytes = 0;
+		std::unique_ptr<Span> span;
+	};
 
 	explicit Connection(
 		State& server_state,
 		boost::asio::io_context& io_context,
-		std::function<void(HttpRequestConnectionUPtr)> request_handler,
-		std::chrono::seconds timeout = std::chrono::seconds{60});
+		RequestHandlerRef request_handler,
+		const ConnectionOptions& options,
+		std::atomic_uint* executor_connections);
 
 	/**
 	 * \brief Set connection timeout.
@@ -82,10 +195,18 @@ private:
 	 * \brief Cancel timeout timer.
 	 */
 	void CancelTimeoutTimer();
+	/**
+	 * \brief Restart timeout timer.
+	 */
+	void RestartTimeoutTimer();
 	/**
 	 * \brief Continue connect after life circle.
 	 */
 	void DoContinueSession();
+	/**
+	 * \brief Close draining connection if request isn't started and nothing is written.
+	 */
+	void CloseIfIdle();
 	/**
 	 * \brief Set timer handler.
 	 */
@@ -95,9 +216,78 @@ private:
 	 */
 	void DoRead();
 	/**
-	 * \brief Write data into socket.
+	 * \brief Pass parsed request through adaptive concurrency limit.
+	 */
+	void AdmitRequest();
+	/**
+	 * \brief Pass pending request to request handler.
+	 */
+	void DispatchRequest();
+	/**
+	 * \brief Answer pending request with 503, connection is closed after it.
+	 */
+	void RejectRequest();
+	/**
+	 * \brief Check if first bytes of request are request line of metrics scrape.
+	 */
+	[[nodiscard]] bool IsMetricsRequestLine(std::string_view data) const noexcept;
+	/**
+	 * \brief Check if request is metrics scrape.
+	 */
+	[[nodiscard]] bool IsMetricsRequest(const HttpRequest& http_request) const noexcept;
+	/**
+	 * \brief Answer request to metrics path.
+	 */
+	void SendMetrics(HttpRequest http_request);
+	/**
+	 * \brief Create trace context of parsed request, continue trace of traceparent header.
+	 */
+	void StartTrace(const HttpRequest& http_request);
+	/**
+	 * \brief Release concurrency limiter slot of handled request.
+	 *
+	 * \param[in] completed Response was produced, so request latency is a sample for limiter.
+	 */
+	void ReleaseConcurrencySlot(bool completed) noexcept;
+	/**
+	 * \brief Add buffer to write queue.
+	 */
+	void DoWrite(OutputData data, WriteCompletion completion, WriteHandler handler);
+	/**
+	 * \brief Write queued buffers into socket, if writing isn't in progress.
+	 */
+	void DoFlush();
+	/**
+	 * \brief Send file region from front of write queue.
+	 */
+	void DoSendFile();
+	/**
+	 * \brief Finish write of buffers in flight.
+	 *
+	 * \param[in] ec Write error.
+	 * \param[in] memory_bytes Written bytes of memory buffers.
+	 */
+	void CompleteWrite(const boost::system::error_code& ec, size_t memory_bytes);
+	/**
+	 * \brief Remove written or dropped bytes from connection and server counters, return bytes left in queue.
+	 */
+	size_t ReleaseQueuedBytes(size_t bytes) noexcept;
+	/**
+	 * \brief Remove request from requests in flight after its response.
+	 */
+	void FinishRequest() noexcept;
+	/**
+	 * \brief Return memory buffer data, empty for file region.
+	 */
+	[[nodiscard]] static std::string_view GetMemoryData(const OutputData& data) noexcept;
+	/**
+	 * \brief Create request object, stored inside connection if it is free.
+	 */
+	[[nodiscard]] HttpRequestConnectionUPtr MakeHttpRequest(HttpRequest http_request);
+	/**
+	 * \brief Destroy request stored inside connection.
 	 */
-	void DoWrite(std::string response, const bool keep_alive = false);
+	void ReleaseRequest() noexcept;
 
 private:
 	//! Server state.
@@ -105,21 +295,63 @@ private:
 	//! Asio context.
 	boost::asio::io_context& io_context_;
 	//! Request handler function.
-	std::function<void(HttpRequestConnectionUPtr)> request_handler_;
+	RequestHandlerRef request_handler_;
 	//! Connection socket.
 	boost::asio::ip::tcp::socket socket_;
 	//! Helps to call write, read and timer wake up consequentially (boost asio socket peculiarities).
 	boost::asio::io_service::strand strand_;
-	//! Connection timeout.
-	std::chrono::seconds timeout_{0};
+	//! Persistent connection settings.
+	const ConnectionOptions options_;
+	//! Connections counter of io context, it is used for connections balancing.
+	std::atomic_uint* const executor_connections_;
+	//! Requests received by connection.
+	size_t requests_count_ = 0;
 	//! Buffer to receive bytes from socket.
 	std::array<char, 8192> buffer_;
 	//! Request parser.
 	HttpRequestParser request_parser_;
-	//! Hold client response.
-	std::string response_;
-	//! Time point when connection started.
-	std::chrono::steady_clock::time_point connection_started_;
+	//! Write queue, front buffers are being written.
+	std::deque<OutputBuffer> write_queue_;
+	//! Count of front buffers being written.
+	size_t buffers_in_flight_ = 0;
+	//! Buffers sequence for gathered write.
+	std::vector<boost::asio::const_buffer> write_buffers_;
+	//! Sent bytes of file region in front of write queue.
+	uint64_t sent_file_bytes_ = 0;
+	//! Bytes added to write queue, but not written yet.
+	std::atomic_size_t queued_bytes_ = 0;
+	//! Write queue is over high watermark.
+	std::atomic_bool write_queue_full_ = false;
+	//! Next request isn't read until write queue is drained.
+	bool read_paused_ = false;
+	//! Current request passed admission control.
+	bool request_admitted_ = false;
+	//! Connection is closed after current response, server is stopped.
+	bool draining_ = false;
+	//! Admitted requests without finished response.
+	unsigned requests_in_flight_ = 0;
+	//! Keep io context running while requests are in flight, handler may answer from other thread after server drain.
+	std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> requests_work_;
+	//! Parsed request waiting for concurrency limiter.
+	std::optional<HttpRequest> pending_request_;
+	//! Expires request waiting for concurrency limiter.
+	std::optional<boost::asio::steady_timer> admission_timer_;
+	//! Time point when request holding concurrency limiter slot was passed to handler.
+	std::optional<std::chrono::steady_clock::time_point> limited_request_started_;
+	//! Phases of current request, they are passed to last buffer of its response.
+	RequestTimeline timeline_;
+	//! Bytes read for current request.
+	size_t request_bytes_ = 0;
+	//! Bytes queued for current response.
+	uint64_t response_bytes_ = 0;
+	//! Time when first buffer of response in front of write queue was written.
+	RequestTimeline::Clock::time_point response_first_written_;
+	//! Status code of current response, it is set by handler thread.
+	mutable std::atomic_uint response_status_code_ = 0;
+	//! Trace context of current request.
+	std::optional<TraceContext> trace_context_;
+	//! Span of current request, if it is sampled.
+	std::unique_ptr<Span> span_;
 	//! Can send new data into socket or not.
 	std::atomic_bool can_write_data_ = false;
 	//! Connection id.
@@ -128,6 +360,10 @@ private:
 	std::optional<boost::asio::steady_timer> timeout_timer_;
 	//! Member indicates that all operation in socket was stopped.
 	std::atomic_bool canceled_ = false;
+	//! Request storage, reused by requests of connection.
+	std::optional<HttpRequestConnection> request_;
+	//! Request storage is used by handler.
+	std::atomic_bool request_in_use_ = false;
 };
 
 using ConnectionPtr = std::shared_ptr<Connection>;
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+
+namespace Http::Server
+{
+
+/**
+ * \brief Placement of server threads on CPUs.
+ *
+ * Pinned io thread allocates its connections itself, so their memory is local to NUMA node of its CPU.
+ */
+struct PlacementOptions final
+{
+	//! CPUs of io threads, thread i is pinned to cpus[i % size] (empty - threads aren't pinned).
+	std::vector<unsigned> cpus;
+	//! CPU of thread calling Run (signals and accepting), nullopt - thread isn't pinned.
+	std::optional<unsigned> accept_cpu;
+};
+
+/**
+ * \brief Parse CPU list like "0-3,8,10-11", CPUs must be less than CPU_SETSIZE.
+ */
+[[nodiscard]] std::vector<unsigned> ParseCpuList(std::string_view list);
+
+/**
+ * \brief Pin calling thread to CPU.
+ */
+[[nodiscard]] bool PinCurrentThread(unsigned cpu) noexcept;
+
+/**
+ * \brief Return CPU which handles received packets of socket (SO_INCOMING_CPU), it follows NIC RX queue IRQ affinity.
+ */
+[[nodiscard]] std::optional<unsigned> GetIncomingCpu(int fd) noexcept;
+
+} // namespace Http::Server
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <Http/HttpResponse.hpp>
+#include <Http/Types.hpp>
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace Http::Server
+{
+
+struct FileMetadata;
+using FileMetadataPtr = std::shared_ptr<const FileMetadata>;
+
+/**
+ * \brief Precompressed sibling of served file (e.g. "index.html.gz").
+ */
+struct FileVariant final
+{
+	//! Content coding of the variant.
+	ContentEncoding encoding = ContentEncoding::Identity;
+	//! Variant file path (relative to root).
+	std::string path;
+	//! Variant file metadata.
+	FileMetadataPtr metadata;
+};
+
+/**
+ * \brief File system information about served file.
+ */
+struct FileMetadata final
+{
+	//! Path is directory.
+	bool is_directory = false;
+	//! Path is regular file.
+	bool is_regular_file = false;
+	//! File size.
+	size_t size = 0;
+	//! Last modification time.
+	std::time_t modification_time = 0;
+	//! Strong entity tag (inode, size and modification time).
+	std::string etag;
+	//! Last modification time in http date format.
+	std::string last_modified;
+	//! Prepared 304 response, sent when client copy is still valid.
+	std::optional<HttpResponse> not_modified_response;
+	//! Precompressed variants, ordered by server preference.
+	std::vector<FileVariant> variants;
+};
+
+/**
+ * \brief Return strong entity tag of file (inode, size and modification time).
+ */
+[[nodiscard]] std::string MakeETag(const struct stat& st);
+
+/**
+ * \brief Thread safe cache of file metadata (stat results), revalidated after ttl.
+ */
+class FileMetadataCache final
+{
+public:
+	FileMetadataCache(const FileMetadataCache&) = delete;
+	FileMetadataCache& operator=(const FileMetadataCache&) = delete;
+
+	FileMetadataCache(FileMetadataCache&&) = delete;
+	FileMetadataCache& operator=(FileMetadataCache&&) = delete;
+
+	/**
+	 * \brief Create cache, paths are resolved relative to root directory descriptor.
+	 */
+	explicit FileMetadataCache(
+		int root_fd,
+		std::chrono::milliseconds ttl = std::chrono::milliseconds{1000},
+		size_t max_entries = 16384);
+
+	/**
+	 * \brief Return file metadata, nullptr if file doesn't exist.
+	 */
+	[[nodiscard]] FileMetadataPtr Get(const std::string& path);
+
+	/**
+	 * \brief Return cached file metadata without file system calls, nullopt if it isn't cached or stale.
+	 */
+	[[nodiscard]] std::optional<FileMetadataPtr> Find(const std::string& path);
+
+private:
+	/**
+	 * \brief Cache entry.
+	 */
+	struct Entry final
+	{
+		//! File metadata (nullptr if file doesn't exist).
+		FileMetadataPtr metadata;
+		//! Time point when metadata was received.
+		std::chrono::steady_clock::time_point checked_at;
+	};
+
+	/**
+	 * \brief Read file metadata from file system.
+	 */
+	[[nodiscard]] std::shared_ptr<FileMetadata> ReadMetadata(const std::string& path) const;
+	/**
+	 * \brief Read file metadata with precompressed variants from file system.
+	 */
+	[[nodiscard]] FileMetadataPtr ReadMetadataWithVariants(const std::string& path) const;
+
+	/**
+	 * \brief Remove stale entries, if cache is full (should be called under lock).
+	 */
+	void Shrink(std::chrono::steady_clock::time_point now);
+
+private:
+	//! Root directory descriptor.
+	const int root_fd_ = -1;
+	//! Time while metadata is valid.
+	const std::chrono::milliseconds ttl_;
+	//! Max cache entries count.
+	const size_t max_entries_ = 0;
+	//! Protect entries.
+	std::mutex mutex_;
+	//! Cached metadata by path.
+	std::unordered_map<std::string, Entry> entries_;
+};
+
+} // namespace Http::Server
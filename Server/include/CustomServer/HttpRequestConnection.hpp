@@ -1,23 +1,36 @@
 #pragma once
 
+#include <CustomServer/ResponseStream.hpp>
+#include <CustomServer/Tracing.hpp>
+
 #include <Http/HttpRequest.hpp>
+#include <Http/HttpResponse.hpp>
 
+#include <functional>
 #include <memory>
+#include <optional>
 #include <string>
+#include <type_traits>
+#include <utility>
 
 
-namespace Http
+namespace Http::Server
 {
 
-class HttpResponse;
+class Connection;
+using ConnectionPtr = std::shared_ptr<Connection>;
 
-} // namespace Http
+class HttpRequestConnection;
 
-namespace Http::Server
+/**
+ * \brief Release http request: request stored inside connection returns to it, other request is deleted.
+ */
+struct HttpRequestConnectionDeleter final
 {
+	void operator()(HttpRequestConnection* http_request) const noexcept;
+};
 
-class Connection;
-using ConnectionPtr = std::shared_ptr<Connection>;
+using HttpRequestConnectionUPtr = std::unique_ptr<HttpRequestConnection, HttpRequestConnectionDeleter>;
 
 /**
  * \brief Hold http connection and can send responce.
@@ -36,33 +49,116 @@ public:
 	/**
 	 * \brief Send responce async (not thread safe).
 	 *
+	 * Shared and file bodies aren't copied, generated body is sent by parts as it is written.
+	 *
 	 * \param[in] msg Msg to send.
 	 *
 	 * \return True if can add msg, false otherwise.
 	 */
 	bool Send(const HttpResponse& msg);
 
+	/**
+	 * \brief Send response headers and return stream for body (not thread safe).
+	 *
+	 * Body of response is ignored. If content length is unknown, body is sent in chunks
+	 * (HTTP/1.0 client gets body until connection is closed).
+	 *
+	 * \param[in] response Response status and headers.
+	 * \param[in] content_length Body length if it is known.
+	 *
+	 * \return Stream, nullopt if response was already sent or connection is closed.
+	 */
+	[[nodiscard]] std::optional<ResponseStream> StartStream(
+		HttpResponse response,
+		std::optional<size_t> content_length = std::nullopt);
+
+	/**
+	 * \brief Execute task in connection context, e.g. send result of work done in other thread.
+	 */
+	void Post(std::function<void()> task);
+
 	/**
 	 * \brief Return http request.
 	 */
 	[[nodiscard]] const HttpRequest& GetRequest() const noexcept;
 
+	/**
+	 * \brief Return trace context of request span, nullopt if tracing is disabled.
+	 *
+	 * Requests to other services should pass it by traceparent header (FormatTraceParent).
+	 */
+	[[nodiscard]] const std::optional<TraceContext>& GetTraceContext() const noexcept;
+
 	/**
 	 * \brief Check if connection is alive.
 	 */
 	[[nodiscard]] bool IsAlive() const noexcept;
 
+	/**
+	 * \brief Return bytes queued for writing in connection.
+	 */
+	[[nodiscard]] size_t GetQueuedBytes() const noexcept;
+
+	/**
+	 * \brief Check if connection write queue is over high watermark, producer should wait.
+	 */
+	[[nodiscard]] bool IsWriteQueueFull() const noexcept;
+
 	~HttpRequestConnection();
 
 private:
+	friend class Connection;
+	friend struct HttpRequestConnectionDeleter;
+
+	//! Request is stored inside connection (isn't allocated).
+	bool embedded_ = false;
 	//! Flag, that http request has already sended.
 	bool response_sended_ = false;
 	//! Http request.
 	HttpRequest request_;
 	//! Pointer to connection.
 	ConnectionPtr connection_;
+	//! Trace context of request span.
+	std::optional<TraceContext> trace_context_;
 };
 
-using HttpRequestConnectionUPtr = std::unique_ptr<HttpRequestConnection>;
+/**
+ * \brief Non-owning reference to request handler, handler is shared by all connections and should outlive server.
+ *
+ * Call costs one call via function pointer, handler itself (e.g. Pipeline) is inlined into it.
+ */
+class RequestHandlerRef final
+{
+public:
+	template <
+		typename Handler,
+		typename = std::enable_if_t<!std::is_same_v<std::remove_cv_t<Handler>, RequestHandlerRef>>>
+	RequestHandlerRef(Handler& handler) noexcept
+		: handler_(const_cast<std::remove_cv_t<Handler>*>(&handler))
+		, call_(&Call<Handler>)
+	{
+	}
+
+	/**
+	 * \brief Pass request to handler.
+	 */
+	void operator()(HttpRequestConnectionUPtr http_request) const
+	{
+		call_(handler_, std::move(http_request));
+	}
+
+private:
+	template <typename Handler>
+	static void Call(void* handler, HttpRequestConnectionUPtr http_request)
+	{
+		(*static_cast<Handler*>(handler))(std::move(http_request));
+	}
+
+private:
+	//! Handler.
+	void* handler_ = nullptr;
+	//! Handler call.
+	void (*call_)(void*, HttpRequestConnectionUPtr) = nullptr;
+};
 
 } // namespace Http::Server
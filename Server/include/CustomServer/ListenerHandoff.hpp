@@ -0,0 +1,46 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+
+namespace Http::Server
+{
+
+/**
+ * \brief Listening socket received from running server.
+ */
+struct HandedOffListener final
+{
+	//! Listening socket.
+	int listener = -1;
+	//! Connection to running server, it stops accepting after confirmation.
+	int channel = -1;
+};
+
+/**
+ * \brief Return listening socket passed by socket activation protocol (LISTEN_PID, LISTEN_FDS), -1 if there isn't.
+ */
+[[nodiscard]] int TakeInheritedListener() noexcept;
+
+/**
+ * \brief Request listening socket from server running with handoff socket path.
+ *
+ * \return Listener and channel, nullopt if there is no running server.
+ */
+[[nodiscard]] std::optional<HandedOffListener> RequestListener(const std::string& path);
+
+/**
+ * \brief Confirm that received listener is used, so running server may stop, close channel.
+ */
+void ConfirmListener(int channel) noexcept;
+
+/**
+ * \brief Send listening socket to new server (SCM_RIGHTS).
+ */
+[[nodiscard]] bool SendListener(int channel, int listener) noexcept;
+
+//! Confirmation byte of new server.
+constexpr char listener_confirmation = '1';
+
+} // namespace Http::Server
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace Http::Server
+{
+
+//! Size of memory kept apart by counters of different threads, adjacent cache lines are prefetched in pairs.
+constexpr size_t counters_alignment = 128;
+
+/**
+ * \brief Recorded distributions of requests.
+ */
+enum class Metric
+{
+	//! Microseconds from first bytes of request to written response.
+	RequestLatency,
+	//! Microseconds from first bytes of request to parsed request.
+	ParseTime,
+	//! Microseconds from passing request to handler to first response bytes.
+	HandlerTime,
+	//! Microseconds from first response bytes to written response.
+	WriteTime,
+	//! Bytes read while request was parsed.
+	RequestSize,
+	//! Response bytes (headers and body).
+	ResponseSize,
+};
+
+//! Count of metrics.
+constexpr size_t metrics_count = static_cast<size_t>(Metric::ResponseSize) + 1;
+
+/**
+ * \brief Log-linear histogram buckets (HDR-style): every power of two is split into equal sub-buckets.
+ *
+ * Relative error of value is below 1 / sub_buckets.
+ */
+class HistogramBuckets final
+{
+public:
+	//! Sub-buckets of power of two.
+	static constexpr size_t sub_buckets = 16;
+	//! Values from 2^max_exponent are counted in last bucket.
+	static constexpr size_t max_exponent = 40;
+	//! Buckets count.
+	static constexpr size_t count = (max_exponent - 3) * sub_buckets;
+
+	/**
+	 * \brief Return bucket of value.
+	 */
+	[[nodiscard]] static size_t GetBucket(uint64_t value) noexcept;
+	/**
+	 * \brief Return max value of bucket.
+	 */
+	[[nodiscard]] static uint64_t GetMaxValue(size_t bucket) noexcept;
+};
+
+/**
+ * \brief Merged histogram.
+ */
+class HistogramSnapshot final
+{
+public:
+	HistogramSnapshot();
+
+	/**
+	 * \brief Return count of values.
+	 */
+	[[nodiscard]] uint64_t GetCount() const noexcept;
+	/**
+	 * \brief Return sum of values.
+	 */
+	[[nodiscard]] uint64_t GetSum() const noexcept;
+	/**
+	 * \brief Return value, which isn't exceeded by quantile of values (max value of its bucket), 0 if empty.
+	 */
+	[[nodiscard]] uint64_t GetQuantile(double quantile) const noexcept;
+
+private:
+	friend class Metrics;
+
+	//! Values in buckets.
+	std::vector<uint64_t> buckets_;
+	//! Count of values.
+	uint64_t count_ = 0;
+	//! Sum of values.
+	uint64_t sum_ = 0;
+};
+
+/**
+ * \brief Request histograms and response status counters.
+ *
+ * Threads record into own shards without locks, shards are merged by readers.
+ */
+class Metrics final
+{
+public:
+	//! Counted status codes are less than it.
+	static constexpr unsigned max_status_code = 600;
+
+	explicit Metrics(size_t shards_count = 1);
+
+	Metrics(const Metrics&) = delete;
+	Metrics& operator=(const Metrics&) = delete;
+
+	Metrics(Metrics&&) = delete;
+	Metrics& operator=(Metrics&&) = delete;
+
+	/**
+	 * \brief Record value into histogram of calling thread shard.
+	 */
+	void Record(Metric metric, uint64_t value) noexcept;
+	/**
+	 * \brief Count response status code.
+	 */
+	void AddResponse(unsigned status_code) noexcept;
+	/**
+	 * \brief Merge histogram of all shards.
+	 */
+	[[nodiscard]] HistogramSnapshot GetHistogram(Metric metric) const;
+	/**
+	 * \brief Return counts of status codes, which were sent.
+	 */
+	[[nodiscard]] std::vector<std::pair<unsigned, uint64_t>> GetResponses() const;
+	/**
+	 * \brief Add collector of metrics outside of server (Prometheus text), it should be added before server is run.
+	 */
+	void AddCollector(std::function<std::string()> collector);
+	/**
+	 * \brief Return collectors of metrics outside of server.
+	 */
+	[[nodiscard]] const std::vector<std::function<std::string()>>& GetCollectors() const noexcept;
+
+private:
+	/**
+	 * \brief Histogram of one shard.
+	 */
+	struct Histogram final
+	{
+		std::array<std::atomic_uint64_t, HistogramBuckets::count> buckets{};
+		std::atomic_uint64_t sum = 0;
+	};
+
+	/**
+	 * \brief Metrics updated by threads of one shard.
+	 */
+	struct alignas(counters_alignment) Shard final
+	{
+		std::array<Histogram, metrics_count> histograms{};
+		std::array<std::atomic_uint64_t, max_status_code> responses{};
+	};
+
+	/**
+	 * \brief Return shard of calling thread.
+	 */
+	[[nodiscard]] Shard& GetShard() noexcept;
+
+private:
+	//! Metrics of threads.
+	std::vector<Shard> shards_;
+	//! Collectors of metrics outside of server, appended to scrape.
+	std::vector<std::function<std::string()>> collectors_;
+};
+
+class State;
+struct BlockingTaskPoolStatistics;
+
+/**
+ * \brief Format server counters and metrics in Prometheus text format.
+ */
+[[nodiscard]] std::string FormatPrometheusMetrics(const State& state);
+
+/**
+ * \brief Format blocking task pool queue statistics in Prometheus text format.
+ */
+[[nodiscard]] std::string FormatPrometheusMetrics(const BlockingTaskPoolStatistics& statistics);
+
+} // namespace Http::Server
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+
+namespace Http::Server
+{
+
+/**
+ * \brief Open path relative to root directory descriptor, resolution can't escape root.
+ *
+ * openat2 with RESOLVE_BENEATH is used where available. If kernel doesn't have it (ENOSYS) or it is
+ * denied (EPERM by seccomp filter), path is opened by components without following any symlink.
+ *
+ * \param[in] root_fd Root directory descriptor.
+ * \param[in] path Normalized path relative to root (without "." and ".." components, "." is root itself).
+ * \param[in] flags Open flags, O_CLOEXEC is added.
+ *
+ * \return File descriptor, -1 on error (errno is set).
+ */
+[[nodiscard]] int OpenBeneath(int root_fd, const std::string& path, int flags);
+
+} // namespace Http::Server
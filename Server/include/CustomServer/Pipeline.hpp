@@ -0,0 +1,179 @@
+#pragma once
+
+#include <CustomServer/HttpRequestConnection.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace Http::Server
+{
+
+template <typename... Layers>
+class Pipeline;
+
+/**
+ * \brief Rest of pipeline after current layer, passed to middleware by value.
+ *
+ * Holds only reference to pipeline, call is resolved at compile time and may be inlined.
+ */
+template <typename PipelineType, size_t Index>
+class NextLayer final
+{
+public:
+	explicit NextLayer(PipelineType& pipeline) noexcept
+		: pipeline_(pipeline)
+	{
+	}
+
+	/**
+	 * \brief Pass request to next layer.
+	 */
+	void operator()(HttpRequestConnectionUPtr http_request) const
+	{
+		pipeline_.template Call<Index>(std::move(http_request));
+	}
+
+private:
+	//! Pipeline.
+	PipelineType& pipeline_;
+};
+
+/**
+ * \brief Middleware chain composed at compile time, e.g. Pipeline<Auth, Metrics, Router>.
+ *
+ * Every layer except last is called as layer(http_request, next) and either answers request
+ * or passes it further via next(std::move(http_request)). Last layer is called as layer(http_request).
+ * Layers are called from many network threads at once, so they should be thread safe.
+ */
+template <typename... Layers>
+class Pipeline final
+{
+	static_assert(sizeof...(Layers) > 0, "Pipeline should have at least one layer");
+
+public:
+	Pipeline() = default;
+
+	explicit Pipeline(Layers... layers)
+		: layers_(std::move(layers)...)
+	{
+	}
+
+	/**
+	 * \brief Handle request by first layer.
+	 */
+	void operator()(HttpRequestConnectionUPtr http_request)
+	{
+		Call<0>(std::move(http_request));
+	}
+
+	/**
+	 * \brief Return layer by index.
+	 */
+	template <size_t Index>
+	[[nodiscard]] auto& Get() noexcept
+	{
+		return std::get<Index>(layers_);
+	}
+
+private:
+	template <typename, size_t>
+	friend class NextLayer;
+
+	/**
+	 * \brief Call layer by index.
+	 */
+	template <size_t Index>
+	void Call(HttpRequestConnectionUPtr http_request)
+	{
+		auto& layer = std::get<Index>(layers_);
+		if constexpr (Index + 1 == sizeof...(Layers))
+		{
+			layer(std::move(http_request));
+		}
+		else
+		{
+			layer(std::move(http_request), NextLayer<Pipeline, Index + 1>{*this});
+		}
+	}
+
+private:
+	//! Layers.
+	std::tuple<Layers...> layers_;
+};
+
+/**
+ * \brief Create pipeline from layers (lambdas are allowed).
+ */
+template <typename... Layers>
+[[nodiscard]] Pipeline<std::decay_t<Layers>...> MakePipeline(Layers&&... layers)
+{
+	return Pipeline<std::decay_t<Layers>...>{std::forward<Layers>(layers)...};
+}
+
+class DynamicPipeline;
+
+/**
+ * \brief Rest of dynamic pipeline after current middleware.
+ */
+class DynamicNext final
+{
+public:
+	DynamicNext(const DynamicPipeline& pipeline, size_t index) noexcept;
+
+	/**
+	 * \brief Pass request to next middleware (or handler after last middleware).
+	 */
+	void operator()(HttpRequestConnectionUPtr http_request) const;
+
+private:
+	//! Pipeline.
+	const DynamicPipeline& pipeline_;
+	//! Next middleware index.
+	size_t index_ = 0;
+};
+
+using DynamicMiddleware = std::function<void(HttpRequestConnectionUPtr, const DynamicNext&)>;
+using DynamicHandler = std::function<void(HttpRequestConnectionUPtr)>;
+
+/**
+ * \brief Middleware chain registered at runtime (e.g. from config).
+ *
+ * Each middleware costs one indirect call. Can be used as last layer of Pipeline.
+ * Middlewares should be registered before server starts.
+ */
+class DynamicPipeline final
+{
+public:
+	explicit DynamicPipeline(DynamicHandler handler);
+
+	/**
+	 * \brief Add middleware to the end of chain (before handler).
+	 */
+	DynamicPipeline& Use(DynamicMiddleware middleware);
+
+	/**
+	 * \brief Handle request by first middleware.
+	 */
+	void operator()(HttpRequestConnectionUPtr http_request) const;
+
+private:
+	friend class DynamicNext;
+
+	/**
+	 * \brief Call middleware by index, handler if index is after last middleware.
+	 */
+	void Call(size_t index, HttpRequestConnectionUPtr http_request) const;
+
+private:
+	//! Middlewares.
+	std::vector<DynamicMiddleware> middlewares_;
+	//! Handler.
+	DynamicHandler handler_;
+};
+
+} // namespace Http::Server
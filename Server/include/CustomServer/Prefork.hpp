@@ -0,0 +1,178 @@
+#pragma once
+
+#include <CustomServer/SocketOptions.hpp>
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace Http::Server
+{
+
+class State;
+
+/**
+ * \brief Master/worker mode settings.
+ */
+struct PreforkOptions final
+{
+	//! Worker processes.
+	size_t workers = 1;
+	//! Every worker has own listener (SO_REUSEPORT), kernel balances connections without shared accept queue.
+	bool reuse_port = false;
+	//! Delay before dead worker is restarted, it limits restarts of crashing worker.
+	std::chrono::milliseconds restart_delay{500};
+	//! Interval of copying worker counters into shared memory.
+	std::chrono::milliseconds publish_interval{1000};
+};
+
+/**
+ * \brief Counters of worker process, they are placed in memory shared with master.
+ */
+struct WorkerCounters final
+{
+	//! Worker process id, 0 if worker isn't running.
+	std::atomic<pid_t> pid = 0;
+	//! Restarts of worker.
+	std::atomic_uint64_t restarts = 0;
+	//! Open connections.
+	std::atomic_uint64_t connections = 0;
+	//! Requests being handled.
+	std::atomic_uint64_t requests_in_flight = 0;
+	//! Requests answered with 503.
+	std::atomic_uint64_t rejected_requests = 0;
+	//! Accepted connections.
+	std::atomic_uint64_t accepted_connections = 0;
+};
+
+/**
+ * \brief Sum of counters of all workers.
+ */
+struct ClusterCounters final
+{
+	//! Running workers.
+	uint64_t workers = 0;
+	//! Restarts of workers.
+	uint64_t restarts = 0;
+	//! Open connections.
+	uint64_t connections = 0;
+	//! Requests being handled.
+	uint64_t requests_in_flight = 0;
+	//! Requests answered with 503.
+	uint64_t rejected_requests = 0;
+	//! Accepted connections.
+	uint64_t accepted_connections = 0;
+};
+
+/**
+ * \brief Copy server state into worker counters from time to time.
+ */
+class CountersPublisher final
+{
+public:
+	CountersPublisher(const CountersPublisher&) = delete;
+	CountersPublisher& operator=(const CountersPublisher&) = delete;
+
+	CountersPublisher(CountersPublisher&&) = delete;
+	CountersPublisher& operator=(CountersPublisher&&) = delete;
+
+	CountersPublisher(const State& state, WorkerCounters& counters, std::chrono::milliseconds interval);
+
+	/**
+	 * \brief Publish last values and stop.
+	 */
+	~CountersPublisher();
+
+private:
+	/**
+	 * \brief Copy state into counters.
+	 */
+	void Publish() noexcept;
+
+private:
+	//! Server state.
+	const State& state_;
+	//! Shared counters.
+	WorkerCounters& counters_;
+	//! Publish interval.
+	const std::chrono::milliseconds interval_;
+	//! Protect stop flag.
+	std::mutex mutex_;
+	//! Wake up publisher on stop.
+	std::condition_variable condition_;
+	//! Publisher is stopped.
+	bool stopped_ = false;
+	//! Publisher thread.
+	std::thread thread_;
+};
+
+/**
+ * \brief Master process: binds listeners, forks workers and restarts dead ones.
+ *
+ * Must be created before any thread is started, workers are forked from it.
+ */
+class PreforkMaster final
+{
+public:
+	//! Worker entry point: run server on listener, return process exit code.
+	using WorkerMain = std::function<int(int listener, WorkerCounters& counters)>;
+
+	PreforkMaster(const PreforkMaster&) = delete;
+	PreforkMaster& operator=(const PreforkMaster&) = delete;
+
+	PreforkMaster(PreforkMaster&&) = delete;
+	PreforkMaster& operator=(PreforkMaster&&) = delete;
+
+	PreforkMaster(
+		const PreforkOptions& options,
+		const std::string& address,
+		const std::string& port,
+		const ListenerOptions& listener_options);
+
+	/**
+	 * \brief Run workers until SIGINT, SIGTERM or SIGQUIT, signal is passed to workers and they are waited.
+	 *
+	 * \return Exit code of master.
+	 */
+	int Run(const WorkerMain& worker_main);
+
+	/**
+	 * \brief Return sum of workers counters.
+	 */
+	[[nodiscard]] ClusterCounters GetCounters() const noexcept;
+
+	~PreforkMaster();
+
+private:
+	/**
+	 * \brief Fork worker, worker process doesn't return from it.
+	 */
+	void StartWorker(size_t index, const WorkerMain& worker_main);
+	/**
+	 * \brief Move counters of dead worker into totals of master.
+	 */
+	void RetireWorker(WorkerCounters& counters) noexcept;
+
+private:
+	//! Settings.
+	const PreforkOptions options_;
+	//! Listeners: one shared or one per worker.
+	std::vector<int> listeners_;
+	//! Counters of workers in shared memory.
+	WorkerCounters* counters_ = nullptr;
+	//! Totals of dead workers.
+	ClusterCounters retired_;
+	//! Time when dead worker should be restarted.
+	std::vector<std::chrono::steady_clock::time_point> restart_times_;
+};
+
+} // namespace Http::Server
@@ -1,18 +1,37 @@
 #pragma once
 
+#include <CustomServer/FileMetadataCache.hpp>
+
+#include <Http/HttpResponse.hpp>
+
+#include <optional>
 #include <string>
 
 namespace Http
 {
 
-struct HttpResponse;
-struct HttpRequest;
+class HttpRequest;
 
 } // namespace Http
 
 namespace Http::Server
 {
 
+/**
+ * \brief Response, which body may be still should be read from file.
+ */
+struct PreparedResponse final
+{
+	PreparedResponse(HttpResponse http_response);
+
+	//! Http response (body is empty if file_path is set).
+	HttpResponse response;
+	//! File to read into response body (relative to doc root).
+	std::optional<std::string> file_path;
+	//! File size (from metadata cache until file is opened).
+	size_t file_size = 0;
+};
+
 /**
  * \brief Http handler.
  */
@@ -25,16 +44,83 @@ public:
 	RequestHandler(RequestHandler&&) = delete;
 	RequestHandler& operator=(RequestHandler&&) = delete;
 
+	/**
+	 * \brief Create handler, doc root is canonicalized and opened once.
+	 */
 	explicit RequestHandler(const std::string& doc_root);
 
+	~RequestHandler();
+
 	/**
-	 * \brief Handle http request.
+	 * \brief Handle http request, file is opened synchronously and sent from its descriptor.
 	 */
 	HttpResponse HandleRequest(const HttpRequest& req);
 
+	/**
+	 * \brief Handle http request without reading file content.
+	 */
+	PreparedResponse PrepareResponse(const HttpRequest& req);
+
+	/**
+	 * \brief Handle http request without file system calls (only cached metadata is used).
+	 *
+	 * \return Prepared response, nullopt if metadata isn't cached or directory should be listed.
+	 */
+	std::optional<PreparedResponse> TryPrepareResponse(const HttpRequest& req);
+
+	/**
+	 * \brief Open file of prepared response, file size and validators are updated from opened file.
+	 *
+	 * Cached metadata may be stale, so served length and ETag always describe the opened file.
+	 *
+	 * \return File descriptor, -1 if file can't be opened or isn't regular file.
+	 */
+	[[nodiscard]] int OpenResponseFile(PreparedResponse& prepared) const;
+
+	/**
+	 * \brief Read file content synchronously, descriptor is closed.
+	 *
+	 * \param[in] fd Opened file descriptor.
+	 * \param[in] size File size.
+	 */
+	[[nodiscard]] static std::optional<std::string> ReadFile(int fd, size_t size);
+
+	/**
+	 * \brief Open file relative to doc root, which can't escape it (see OpenBeneath).
+	 *
+	 * \return File descriptor, -1 on error.
+	 */
+	[[nodiscard]] int OpenFile(const std::string& path, int flags) const;
+
+private:
+	/**
+	 * \brief Handle http request without reading file content.
+	 *
+	 * \param[in] may_block Metadata cache misses and directory listing are allowed.
+	 *
+	 * \return Prepared response, nullopt if it needs blocking file system calls, which aren't allowed.
+	 */
+	std::optional<PreparedResponse> DoPrepareResponse(const HttpRequest& req, bool may_block);
+	/**
+	 * \brief Return html directory listing.
+	 */
+	[[nodiscard]] std::optional<std::string> ListDirectory(
+		const std::string& relative_path,
+		const std::string& request_path,
+		bool is_root) const;
+
+	/**
+	 * \brief Check conditional request headers, return true if client copy is still valid.
+	 */
+	[[nodiscard]] static bool IsNotModified(const HttpRequest& req, const FileMetadata& metadata);
+
 private:
-	//! The directory containing the files to be served.
+	//! The directory containing the files to be served (canonical path).
 	std::string doc_root_;
+	//! Doc root directory descriptor, all files are opened relative to it.
+	int root_fd_ = -1;
+	//! Served files metadata.
+	FileMetadataCache metadata_cache_;
 };
 
 } // namespace Http::Server
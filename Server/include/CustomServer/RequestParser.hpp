@@ -283,6 +283,10 @@ public:
 	 * \brief Pop http request from parser, if possible.
 	 */
 	[[nodiscard]] std::optional<HttpRequest> PopHttpRequest() noexcept;
+	/**
+	 * \brief Check if request line and headers are parsed.
+	 */
+	[[nodiscard]] bool IsHeadersParsed() const noexcept;
 
 private:
 	//! Parser status.
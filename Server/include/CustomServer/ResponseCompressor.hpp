@@ -0,0 +1,170 @@
+#pragma once
+
+#include <Http/HttpBody.hpp>
+#include <Http/Types.hpp>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace Http
+{
+
+class HttpRequest;
+class HttpResponse;
+
+} // namespace Http
+
+namespace Http::Server
+{
+
+/**
+ * \brief On the fly compression settings.
+ */
+struct CompressionOptions final
+{
+	//! Compress responses or not.
+	bool enabled = true;
+	//! Bodies smaller than this size are sent as is.
+	size_t min_size = 1024;
+	//! Compression level (zlib 1 - 9, zstd 1 - 19).
+	int level = 6;
+	//! Content type prefixes to compress.
+	std::vector<std::string> content_types = {
+		"text/",
+		"application/json",
+		"application/javascript",
+		"application/xml",
+		"image/svg+xml",
+	};
+	//! Compressed bodies cache size in bytes (0 disables cache).
+	size_t cache_size = 64 * 1024 * 1024;
+};
+
+/**
+ * \brief State of response compression, which is prepared before body is available.
+ */
+enum class PendingCompression
+{
+	//! Response is sent as is.
+	None,
+	//! Response is complete (not modified or cached compressed body), body isn't needed.
+	Done,
+	//! Body should be passed to CompressPrepared.
+	NeedsBody,
+};
+
+/**
+ * \brief Response pipeline stage, compresses response body according to Accept-Encoding.
+ *
+ * Compressed bodies of responses with ETag are cached by (path, ETag, encoding). On cache miss large body
+ * is compressed by bounded input chunks while it is sent, only cacheable output is kept in memory.
+ */
+class ResponseCompressor final
+{
+public:
+	ResponseCompressor(const ResponseCompressor&) = delete;
+	ResponseCompressor& operator=(const ResponseCompressor&) = delete;
+
+	ResponseCompressor(ResponseCompressor&&) = delete;
+	ResponseCompressor& operator=(ResponseCompressor&&) = delete;
+
+	explicit ResponseCompressor(CompressionOptions options = {});
+
+	/**
+	 * \brief Compress response body if client accepts it.
+	 *
+	 * Response is replaced with 304, if client has valid copy of compressed representation.
+	 *
+	 * \return True if body was compressed, false otherwise.
+	 */
+	bool Compress(const HttpRequest& request, HttpResponse& response);
+
+	/**
+	 * \brief Prepare compression of response, which body isn't set yet (e.g. file isn't read).
+	 *
+	 * Conditional requests and compressed bodies cache are checked by response headers only.
+	 *
+	 * \param[in] body_size Size of body, which would be set.
+	 */
+	PendingCompression PrepareCompression(const HttpRequest& request, HttpResponse& response, uint64_t body_size);
+
+	/**
+	 * \brief Compress body after PrepareCompression returned NeedsBody.
+	 *
+	 * Large body is compressed by chunks while response is sent (chunked, without Content-Length).
+	 */
+	void CompressPrepared(const HttpRequest& request, HttpResponse& response, std::string body);
+
+private:
+	/**
+	 * \brief Check if response could be compressed.
+	 */
+	[[nodiscard]] bool IsCompressible(const HttpResponse& response, uint64_t body_size) const;
+	/**
+	 * \brief Return best supported content coding accepted by client.
+	 */
+	[[nodiscard]] static ContentEncoding SelectEncoding(const HttpRequest& request);
+	/**
+	 * \brief Return cache key of compressed body, nullopt if it isn't cached.
+	 */
+	[[nodiscard]] std::optional<std::string> MakeCacheKey(
+		const HttpRequest& request,
+		const HttpResponse& response,
+		ContentEncoding encoding) const;
+	/**
+	 * \brief Set headers of compressed representation.
+	 */
+	static void SetEncodedHeaders(HttpResponse& response, ContentEncoding encoding);
+	/**
+	 * \brief Compress body with content coding.
+	 */
+	[[nodiscard]] std::string CompressBody(const std::string& body, ContentEncoding encoding) const;
+	/**
+	 * \brief Return generator of compressed body, output is put into cache after last part.
+	 */
+	[[nodiscard]] BodyGenerator MakeCompressingGenerator(
+		std::string body,
+		ContentEncoding encoding,
+		std::optional<std::string> cache_key);
+	/**
+	 * \brief Return cached compressed body, nullptr if cache doesn't contain it.
+	 */
+	[[nodiscard]] std::shared_ptr<const std::string> FindInCache(const std::string& key);
+	/**
+	 * \brief Put compressed body into cache.
+	 */
+	void AddToCache(const std::string& key, std::shared_ptr<const std::string> body);
+
+private:
+	/**
+	 * \brief Cache entry.
+	 */
+	struct CacheEntry final
+	{
+		//! Cache key.
+		std::string key;
+		//! Compressed body.
+		std::shared_ptr<const std::string> body;
+	};
+	using CacheList = std::list<CacheEntry>;
+
+	//! Compression settings.
+	const CompressionOptions options_;
+	//! Protect cache.
+	std::mutex cache_mutex_;
+	//! Cache entries, most recently used first.
+	CacheList cache_list_;
+	//! Cache entries by key.
+	std::unordered_map<std::string, CacheList::iterator> cache_index_;
+	//! Cached bytes.
+	size_t cache_bytes_ = 0;
+};
+
+} // namespace Http::Server
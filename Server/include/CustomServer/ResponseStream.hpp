@@ -0,0 +1,80 @@
+#pragma once
+
+#include <boost/system/error_code.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+
+namespace Http::Server
+{
+
+class Connection;
+using ConnectionPtr = std::shared_ptr<Connection>;
+
+//! Called in connection context when buffer is written into socket (or writing failed).
+using WriteHandler = std::function<void(const boost::system::error_code&)>;
+
+/**
+ * \brief Response body writer, headers are already sent when stream is created.
+ *
+ * Body is sent with "Transfer-Encoding: chunked" if its length is unknown.
+ * Stream should be finished, otherwise connection is closed on stream destruction (client sees incomplete response).
+ * Stream isn't thread safe.
+ */
+class ResponseStream final
+{
+public:
+	ResponseStream(ConnectionPtr connection, bool chunked, bool headers_only, bool keep_alive) noexcept;
+
+	ResponseStream(const ResponseStream&) = delete;
+	ResponseStream& operator=(const ResponseStream&) = delete;
+
+	ResponseStream(ResponseStream&& other) noexcept;
+	ResponseStream& operator=(ResponseStream&& other) noexcept;
+
+	/**
+	 * \brief Send part of body asynchronously.
+	 *
+	 * \param[in] data Body part.
+	 * \param[in] handler Called when data is written.
+	 *
+	 * \return True if data is queued, false if stream is finished or connection is closed.
+	 */
+	bool Write(std::string data, WriteHandler handler = {});
+
+	/**
+	 * \brief Finish response.
+	 *
+	 * \return True if end of response is queued, false if stream is finished or connection is closed.
+	 */
+	bool Finish(WriteHandler handler = {});
+
+	/**
+	 * \brief Check if connection write queue is over high watermark, producer should wait.
+	 */
+	[[nodiscard]] bool IsWriteQueueFull() const noexcept;
+
+	~ResponseStream();
+
+private:
+	/**
+	 * \brief Close connection if response isn't finished.
+	 */
+	void Abort() noexcept;
+
+private:
+	//! Connection.
+	ConnectionPtr connection_;
+	//! Body is sent in chunks.
+	bool chunked_ = false;
+	//! Body isn't sent (e.g. response to HEAD).
+	bool headers_only_ = false;
+	//! Keep connection alive after response.
+	bool keep_alive_ = false;
+	//! Response is finished.
+	bool finished_ = false;
+};
+
+} // namespace Http::Server
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <CustomServer/HttpRequestConnection.hpp>
+
+#include <Http/Types.hpp>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+namespace Http::Server
+{
+
+/**
+ * \brief Values captured by route (":name" and "*name"), views into request path.
+ */
+class RouteParameters final
+{
+public:
+	//! Max captures per route.
+	static constexpr size_t max_size = 8;
+
+	/**
+	 * \brief Capture.
+	 */
+	struct Parameter final
+	{
+		std::string_view name;
+		std::string_view value;
+	};
+
+	/**
+	 * \brief Return captured value by name.
+	 */
+	[[nodiscard]] std::optional<std::string_view> Find(std::string_view name) const noexcept;
+	/**
+	 * \brief Return captures count.
+	 */
+	[[nodiscard]] size_t Size() const noexcept;
+	/**
+	 * \brief Return capture by index.
+	 */
+	[[nodiscard]] const Parameter& operator[](size_t index) const noexcept;
+
+private:
+	friend class Router;
+
+	//! Captures.
+	std::array<Parameter, max_size> parameters_;
+	//! Captures count.
+	size_t size_ = 0;
+};
+
+using RouteHandler = std::function<void(HttpRequestConnectionUPtr, const RouteParameters&)>;
+
+/**
+ * \brief Immutable request router (radix tree over path), created by RouterBuilder.
+ *
+ * Routes without captures are found by one hash lookup, other routes in O(path length).
+ * Lookup doesn't allocate. Routes match raw (not percent-decoded) path.
+ */
+class Router final
+{
+public:
+	/**
+	 * \brief Route lookup result.
+	 */
+	enum class MatchStatus
+	{
+		Found,
+		NotFound,
+		MethodNotAllowed,
+	};
+
+	/**
+	 * \brief Route lookup result with handler and captures.
+	 */
+	struct Match final
+	{
+		//! Lookup status.
+		MatchStatus status = MatchStatus::NotFound;
+		//! Route handler (set if route is found).
+		const RouteHandler* handler = nullptr;
+		//! Captured values.
+		RouteParameters parameters;
+		//! Bit (1 << method) of every method routed for path, set if status is MethodNotAllowed.
+		uint32_t allowed_methods = 0;
+	};
+
+public:
+	Router(const Router&) = delete;
+	Router& operator=(const Router&) = delete;
+
+	Router(Router&&) = default;
+	Router& operator=(Router&&) = default;
+
+	/**
+	 * \brief Find route for method and path.
+	 */
+	[[nodiscard]] Match Find(HttpMethodType method, std::string_view path) const noexcept;
+
+	/**
+	 * \brief Dispatch request to route handler, answer 404 or 405 (with Allow header) if route isn't found.
+	 */
+	void operator()(HttpRequestConnectionUPtr http_request) const;
+
+private:
+	friend class RouterBuilder;
+
+	Router() = default;
+
+	//! Invalid index.
+	static constexpr uint32_t npos = UINT32_MAX;
+	//! Methods count.
+	static constexpr size_t methods_count = static_cast<size_t>(HttpMethodType::Unknown);
+
+	using MethodHandlers = std::array<uint32_t, methods_count>;
+
+	/**
+	 * \brief Tree node.
+	 */
+	struct Node final
+	{
+		//! Literal part of path.
+		std::string prefix;
+		//! Literal children, first chars of prefixes are different.
+		std::vector<uint32_t> children;
+		//! Child for ":name" capture.
+		uint32_t parameter_child = npos;
+		//! Child for "*name" capture.
+		uint32_t wildcard_child = npos;
+		//! Capture name (for capture nodes).
+		std::string parameter_name;
+		//! Handler index by method.
+		MethodHandlers handlers = MakeEmptyHandlers();
+	};
+
+	/**
+	 * \brief Return handlers without routes.
+	 */
+	[[nodiscard]] static MethodHandlers MakeEmptyHandlers() noexcept;
+
+	/**
+	 * \brief Find route in subtree of node (node prefix is already matched), return true if found.
+	 */
+	bool FindInNode(
+		uint32_t node_index,
+		HttpMethodType method,
+		std::string_view path,
+		Match& match) const noexcept;
+
+	/**
+	 * \brief Match rest of path (may be empty) by wildcard child of node.
+	 */
+	bool FindInWildcard(
+		const Node& node,
+		HttpMethodType method,
+		std::string_view path,
+		Match& match) const noexcept;
+
+	/**
+	 * \brief Fill match by method handlers.
+	 */
+	[[nodiscard]] bool SetMatch(const MethodHandlers& handlers, HttpMethodType method, Match& match) const noexcept;
+
+private:
+	//! Tree nodes, root is first.
+	std::vector<Node> nodes_;
+	//! Route handlers.
+	std::vector<RouteHandler> handlers_;
+	//! Paths of routes without captures.
+	std::vector<std::string> static_paths_;
+	//! Handlers of routes without captures (keys are views into static_paths_, so router isn't copyable).
+	std::unordered_map<std::string_view, MethodHandlers> static_routes_;
+};
+
+/**
+ * \brief Collects routes and builds router.
+ *
+ * Pattern segment ":name" captures one path segment ("/users/:id/posts"),
+ * last segment "*name" captures rest of path, which may be empty (path ending with slash before it matches).
+ */
+class RouterBuilder final
+{
+public:
+	RouterBuilder();
+
+	/**
+	 * \brief Add route, throws on conflicts and incorrect patterns.
+	 */
+	RouterBuilder& Add(HttpMethodType method, std::string_view pattern, RouteHandler handler);
+
+	/**
+	 * \brief Build router, builder is empty after it.
+	 */
+	[[nodiscard]] Router Build();
+
+private:
+	/**
+	 * \brief Return child index by first char, npos if not found.
+	 */
+	[[nodiscard]] uint32_t FindLiteralChild(uint32_t node_index, char first_char) const noexcept;
+	/**
+	 * \brief Insert literal part of pattern, return node where literal ends.
+	 */
+	[[nodiscard]] uint32_t InsertLiteral(uint32_t node_index, std::string_view literal);
+	/**
+	 * \brief Insert capture child.
+	 */
+	[[nodiscard]] uint32_t InsertCapture(uint32_t node_index, std::string_view name, bool wildcard);
+	/**
+	 * \brief Add node, return its index.
+	 */
+	[[nodiscard]] uint32_t AddNode(Router::Node node);
+
+private:
+	//! Router under construction.
+	Router router_;
+	//! Handlers of routes without captures by path.
+	std::unordered_map<std::string, Router::MethodHandlers> static_routes_;
+};
+
+} // namespace Http::Server
@@ -1,12 +1,17 @@
 #pragma once
 
 #include <CustomServer/Connection.hpp>
+#include <CustomServer/CpuAffinity.hpp>
 #include <CustomServer/HttpRequestConnection.hpp>
 #include <CustomServer/ServerState.hpp>
+#include <CustomServer/SocketOptions.hpp>
 
 #include <boost/asio.hpp>
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <thread>
 #include <string>
 #include <functional>
@@ -18,6 +23,9 @@ namespace Http::Server
 
 /**
  * \brief Http server.
+ *
+ * Signals and accepting are handled by thread calling Run, every io thread has own io context,
+ * so connections of different threads don't share queue of handlers.
  */
 class Server
 {
@@ -28,41 +36,128 @@ public:
 	Server(Server&&) = delete;
 	Server& operator=(Server&&) = delete;
 
-	//TODO may improve server speed if one thread (shed strand and other)
+	/**
+	 * \brief Create server, request handler is shared by all connections and should outlive server.
+	 */
 	explicit Server(
 		size_t thread_count,
 		const std::string& address,
 		const std::string& port,
-		std::function<void(HttpRequestConnectionUPtr)> request_handler);
+		RequestHandlerRef request_handler,
+		const ConnectionOptions& connection_options = {},
+		const AdmissionOptions& admission_options = {},
+		const ListenerOptions& listener_options = {},
+		const PlacementOptions& placement_options = {});
 
 	/**
 	* \brief Http server.
 	*/
   void Run();
 
+	/**
+	 * \brief Return server state.
+	 */
+	[[nodiscard]] State& GetState() noexcept;
+	[[nodiscard]] const State& GetState() const noexcept;
+
+	/**
+	 * \brief Return connections accepting statistics.
+	 */
+	[[nodiscard]] AcceptStats GetAcceptStats();
+
 private:
+	/**
+	 * \brief Io thread context.
+	 */
+	struct Worker final
+	{
+		// Counters are declared before context: handlers left in stopped context destroy connections, which update them.
+		//! Connections of context.
+		std::atomic_uint connections = 0;
+		//! Connections started in context, they are drained on stop (used only by thread of context).
+		std::vector<std::weak_ptr<Connection>> started_connections;
+		//! CPU of thread, nullopt if thread isn't pinned.
+		std::optional<unsigned> cpu;
+		//! Context is run by one thread.
+		boost::asio::io_context io_context{1};
+		//! Keep context running while server accepts connections.
+		std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work;
+	};
+
 	/**
 	* \brief Start accept new connection.
 	*/
 	void StartAccept();
+	/**
+	 * \brief Pause accepting, it is resumed by timer.
+	 */
+	void PauseAccept();
+	/**
+	 * \brief Accept pending connections until accept queue is empty or batch is full.
+	 *
+	 * \return False if accepting should be paused (connections limit or lack of resources).
+	 */
+	[[nodiscard]] bool AcceptBatch();
+	/**
+	 * \brief Pass accepted socket to io thread.
+	 */
+	void PassConnection(int fd, const boost::asio::ip::tcp& protocol);
+	/**
+	 * \brief Create and start connection in io thread, so its memory is allocated by this thread.
+	 */
+	void StartConnection(Worker& worker, int fd, const boost::asio::ip::tcp& protocol);
+	/**
+	 * \brief Select io thread of new connection.
+	 */
+	[[nodiscard]] Worker& SelectWorker(int fd) noexcept;
+	/**
+	 * \brief Stop accepting and drain connections.
+	 */
+	void Shutdown();
+	/**
+	 * \brief Wait for new server on handoff socket, pass listener to it and shutdown after its confirmation.
+	 */
+	void StartHandoff();
+	/**
+	 * \brief Close idle connections, let others finish started requests, let io threads exit after them.
+	 */
+	void DrainConnections();
 
 private:
 	//! Thread count.
 	const size_t thread_count_ = 1;
-	//! Boost asio context.
-	boost::asio::io_context io_context_;
-	//! Sync get signal and accept new connection.
-	boost::asio::io_service::strand strand_;
+	//! Context of signals and accepting, it is run by one thread, so handlers don't need strand.
+	boost::asio::io_context io_context_{1};
 	//! Server state.
 	State state_;
+	//! Io threads contexts.
+	std::vector<std::unique_ptr<Worker>> workers_;
+	//! Next io thread for round robin balancing.
+	size_t next_worker_ = 0;
 	//! Thread pool.
 	std::vector<std::thread> work_threads_;
 	//! Signals handler.
 	boost::asio::signal_set signals_;
 	//! Connections acceptor.
 	boost::asio::ip::tcp::acceptor acceptor_;
-	//! Requests handler callback.
-	std::function<void(HttpRequestConnectionUPtr)> request_handler_;
+	//! Handoff socket of hot restart.
+	boost::asio::local::stream_protocol::acceptor handoff_acceptor_;
+	//! Connection of new server, which requests listener.
+	std::optional<boost::asio::local::stream_protocol::socket> handoff_channel_;
+	//! Confirmation of new server.
+	char handoff_confirmation_ = 0;
+	//! Channel to previous server, it stops after confirmation when server runs (-1 if listener isn't handed off).
+	int previous_server_channel_ = -1;
+	//! Resumes accepting after pause, when connections limit is reached.
+	boost::asio::steady_timer accept_timer_;
+	//! Requests handler.
+	RequestHandlerRef request_handler_;
+	//! Persistent connection settings.
+	const ConnectionOptions connection_options_;
+	//! Listening and accepted sockets settings.
+	const ListenerOptions listener_options_;
+	//! Placement of threads on CPUs.
+	const PlacementOptions placement_options_;
 };
 
 } // namespace Http::Server
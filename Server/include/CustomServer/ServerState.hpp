@@ -1,13 +1,126 @@
 #pragma once
 
+#include <CustomServer/ConcurrencyLimiter.hpp>
+#include <CustomServer/Metrics.hpp>
+
+#include <Http/HttpBody.hpp>
+
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 namespace Http::Server
 {
 
+/**
+ * \brief Load limits, server sheds load above them to keep latency of served clients bounded.
+ */
+struct AdmissionOptions final
+{
+	//! Max open connections, accepting is paused above it (0 means unlimited).
+	unsigned max_connections = 10000;
+	//! Max requests being handled, new requests are answered with 503 above it (0 means unlimited).
+	unsigned max_requests_in_flight = 4096;
+	//! Max bytes queued for writing by all connections, new requests are answered with 503 above it (0 means unlimited).
+	size_t max_buffered_bytes = 256 * 1024 * 1024;
+	//! Retry-After of 503 response.
+	std::chrono::seconds retry_after{1};
+	//! Pause before next accept when connections limit is reached.
+	std::chrono::milliseconds accept_pause{100};
+	//! Adaptive limit of handled requests, disabled if not set.
+	std::optional<ConcurrencyLimiterOptions> adaptive_concurrency;
+};
+
+/**
+ * \brief Connections accepting statistics.
+ */
+struct AcceptStats final
+{
+	//! Accepted connections.
+	uint64_t accepted = 0;
+	//! Accept batches (wake ups of listener with pending connections).
+	uint64_t batches = 0;
+	//! Failed accepts.
+	uint64_t errors = 0;
+	//! Pauses of accepting because of connections limit or lack of resources.
+	uint64_t pauses = 0;
+	//! Connections waiting in accept queue of listener.
+	uint64_t queue_length = 0;
+	//! Connections dropped by kernel because accept queue was full (all listeners of system).
+	uint64_t listen_overflows = 0;
+};
+
+/**
+ * \brief Errors of connections.
+ */
+enum class ConnectionError
+{
+	//! Socket reading failed (closing by client isn't error).
+	Read,
+	//! Socket writing failed.
+	Write,
+	//! Request can't be parsed.
+	BadRequest,
+	//! Connection is closed by timeout.
+	Timeout,
+};
+
+/**
+ * \brief Snapshot of server counters.
+ */
+struct ServerCounters final
+{
+	//! Open connections.
+	uint64_t connections = 0;
+	//! Requests being handled.
+	uint64_t requests_in_flight = 0;
+	//! Finished requests.
+	uint64_t requests = 0;
+	//! Requests answered with 503.
+	uint64_t rejected_requests = 0;
+	//! Bytes queued for writing.
+	uint64_t buffered_bytes = 0;
+	//! Bytes read from sockets.
+	uint64_t bytes_received = 0;
+	//! Bytes written into sockets.
+	uint64_t bytes_sent = 0;
+	//! Connection errors.
+	uint64_t read_errors = 0;
+	uint64_t write_errors = 0;
+	uint64_t bad_requests = 0;
+	uint64_t timeouts = 0;
+};
+
+/**
+ * \brief Server counters and load limits.
+ *
+ * Counters are split into shards of threads, so updates don't move cache lines between cores. Readers sum shards,
+ * limits may be exceeded by concurrent updates of different threads.
+ */
 class State final
 {
 public:
+	/**
+	 * \param shards_count Counter shards, threads bound to different shards don't share cache lines.
+	 */
+	explicit State(const AdmissionOptions& admission_options = {}, size_t shards_count = 1);
+
+	/**
+	 * \brief Bind calling thread to counter shard (shard index is taken modulo shards count).
+	 *
+	 * Threads, which aren't bound, get shards in order of their first update.
+	 */
+	static void BindCurrentThread(size_t shard) noexcept;
+	/**
+	 * \brief Return counter shard of calling thread (not taken modulo shards count).
+	 */
+	[[nodiscard]] static size_t GetCurrentThreadShard() noexcept;
+
 	/**
 	 * \brief Add conenction.
 	 */
@@ -16,6 +129,89 @@ public:
 	 * \brief Remove connection.
 	 */
 	void RemoveConnection() noexcept;
+	/**
+	 * \brief Check if connections limit allows to accept new connection.
+	 */
+	[[nodiscard]] bool CanAcceptConnection() const noexcept;
+	/**
+	 * \brief Add request in flight if limits allow it.
+	 *
+	 * \return True if request is admitted, false if it should be answered with 503.
+	 */
+	[[nodiscard]] bool TryAddRequest() noexcept;
+	/**
+	 * \brief Add request in flight without limits check (request exempt from admission control).
+	 */
+	void AddRequest() noexcept;
+	/**
+	 * \brief Remove request in flight (response is sent).
+	 */
+	void RemoveRequest() noexcept;
+	/**
+	 * \brief Return requests in flight.
+	 */
+	[[nodiscard]] unsigned RequestsInFlight() const noexcept;
+	/**
+	 * \brief Add bytes queued for writing.
+	 */
+	void AddBufferedBytes(size_t bytes) noexcept;
+	/**
+	 * \brief Remove bytes queued for writing (written or dropped).
+	 */
+	void RemoveBufferedBytes(size_t bytes) noexcept;
+	/**
+	 * \brief Return pre-serialized 503 response with Retry-After, connection is closed after it.
+	 */
+	[[nodiscard]] const SharedBuffer& GetOverloadResponse() const noexcept;
+	/**
+	 * \brief Return load limits.
+	 */
+	[[nodiscard]] const AdmissionOptions& GetAdmissionOptions() const noexcept;
+	/**
+	 * \brief Return count of requests answered with 503.
+	 */
+	[[nodiscard]] uint64_t RejectedRequestsCount() const noexcept;
+	/**
+	 * \brief Count bytes read from socket.
+	 */
+	void AddBytesReceived(size_t bytes) noexcept;
+	/**
+	 * \brief Count bytes written into socket.
+	 */
+	void AddBytesSent(size_t bytes) noexcept;
+	/**
+	 * \brief Count connection error.
+	 */
+	void AddError(ConnectionError error) noexcept;
+	/**
+	 * \brief Return sum of counters of all shards.
+	 */
+	[[nodiscard]] ServerCounters GetCounters() const noexcept;
+	/**
+	 * \brief Return request metrics.
+	 */
+	[[nodiscard]] Metrics& GetMetrics() noexcept;
+	[[nodiscard]] const Metrics& GetMetrics() const noexcept;
+	/**
+	 * \brief Count batch of accepted connections.
+	 */
+	void AddAcceptBatch(size_t accepted) noexcept;
+	/**
+	 * \brief Count failed accept.
+	 */
+	void AddAcceptError() noexcept;
+	/**
+	 * \brief Count pause of accepting.
+	 */
+	void AddAcceptPause() noexcept;
+	/**
+	 * \brief Return accepting statistics collected by state (listener statistics aren't filled).
+	 */
+	[[nodiscard]] AcceptStats GetAcceptStats() const noexcept;
+	/**
+	 * \brief Return adaptive concurrency limiter, nullptr if it is disabled.
+	 */
+	[[nodiscard]] ConcurrencyLimiter* GetConcurrencyLimiter() noexcept;
 	/**
 	 * \brief Stop conneciton if server work.
 	 */
@@ -25,20 +221,73 @@ public:
 	 */
 	[[nodiscard]] unsigned ConnectionCount() const noexcept;
 	/**
-	 * \brief Check if server is working.
+	 * \brief Wait until all connections of stopped server are closed.
+	 *
+	 * \return False if deadline is reached.
 	 */
-	[[nodiscard]] bool HasConnections() const noexcept;
+	[[nodiscard]] bool WaitConnectionsClosed(std::chrono::steady_clock::time_point deadline);
 	/**
 	 * \brief Check if server was stopped.
 	 */
 	[[nodiscard]] bool IsStopped() const noexcept;
 
 private:
-	// TODO change into hardware_destructive_interference_size
-	//! Server conenction count.
-	alignas(128) std::atomic_uint connection_count_ = 0;
+	/**
+	 * \brief Counters updated by threads of one shard.
+	 *
+	 * Value added by one thread may be removed by other one (e.g. connection is destroyed by handler thread), so
+	 * gauges are signed and only their sum is meaningful.
+	 */
+	struct alignas(counters_alignment) Shard final
+	{
+		std::atomic_int64_t connections = 0;
+		std::atomic_int64_t requests_in_flight = 0;
+		std::atomic_int64_t buffered_bytes = 0;
+		std::atomic_uint64_t requests = 0;
+		std::atomic_uint64_t rejected_requests = 0;
+		std::atomic_uint64_t bytes_received = 0;
+		std::atomic_uint64_t bytes_sent = 0;
+		std::atomic_uint64_t read_errors = 0;
+		std::atomic_uint64_t write_errors = 0;
+		std::atomic_uint64_t bad_requests = 0;
+		std::atomic_uint64_t timeouts = 0;
+	};
+
+	/**
+	 * \brief Return shard of calling thread.
+	 */
+	[[nodiscard]] Shard& GetShard() noexcept;
+	/**
+	 * \brief Sum gauge of all shards.
+	 */
+	[[nodiscard]] uint64_t Sum(std::atomic_int64_t Shard::*gauge) const noexcept;
+	/**
+	 * \brief Sum counter of all shards.
+	 */
+	[[nodiscard]] uint64_t Sum(std::atomic_uint64_t Shard::*counter) const noexcept;
+
+private:
+	//! Load limits.
+	const AdmissionOptions admission_options_;
+	//! Answer to requests above limits.
+	const SharedBuffer overload_response_;
+	//! Adaptive concurrency limiter.
+	const std::unique_ptr<ConcurrencyLimiter> concurrency_limiter_;
+	//! Counters of threads.
+	std::vector<Shard> shards_;
+	//! Request metrics, sharded in the same way as counters.
+	Metrics metrics_;
+	//! Accepted connections, batches, errors and pauses are counted only by accepting thread.
+	alignas(counters_alignment) std::atomic_uint64_t accepted_connections_ = 0;
+	std::atomic_uint64_t accept_batches_ = 0;
+	std::atomic_uint64_t accept_errors_ = 0;
+	std::atomic_uint64_t accept_pauses_ = 0;
 	//! Server was stooped.
-	alignas(128) std::atomic_bool stopped_ = false;
+	alignas(counters_alignment) std::atomic_bool stopped_ = false;
+	//! Protect waiting of closed connections.
+	std::mutex connections_mutex_;
+	//! Notified when last connection of stopped server is closed.
+	std::condition_variable connections_closed_;
 };
 
 } // namespace Http::Server
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+
+namespace Http::Server
+{
+
+/**
+ * \brief TCP keepalive probes settings.
+ */
+struct TcpKeepAlive final
+{
+	//! Idle time before first probe.
+	std::chrono::seconds idle{60};
+	//! Time between probes.
+	std::chrono::seconds interval{10};
+	//! Unanswered probes before connection is dropped.
+	int count = 6;
+};
+
+/**
+ * \brief How accepted connections are distributed between io threads.
+ */
+enum class AcceptBalancing
+{
+	//! Io threads in turn.
+	RoundRobin,
+	//! Io thread with min connections count.
+	LeastLoaded,
+	//! Io thread pinned to CPU handling received packets of connection (NIC RX queue), round robin if there isn't.
+	IncomingCpu,
+};
+
+/**
+ * \brief Listening and accepted sockets settings, system defaults are kept for unset values.
+ */
+struct ListenerOptions final
+{
+	//! Listen backlog.
+	int backlog = boost::asio::socket_base::max_listen_connections;
+	//! Max connections accepted on one wake up of listener, other io work isn't delayed by connections storm.
+	size_t max_accept_batch = 64;
+	//! Distribution of accepted connections between io threads.
+	AcceptBalancing balancing = AcceptBalancing::RoundRobin;
+	//! Allow bind while old connections are in TIME_WAIT (SO_REUSEADDR).
+	bool reuse_address = true;
+	//! Allow many listeners on the same port, kernel balances connections between them (SO_REUSEPORT).
+	bool reuse_port = false;
+	//! Disable Nagle algorithm on accepted sockets (TCP_NODELAY), small responses aren't delayed.
+	bool no_delay = true;
+	//! Connection is accepted only when request data arrives or time passes (TCP_DEFER_ACCEPT).
+	std::optional<std::chrono::seconds> defer_accept;
+	//! Max pending TCP Fast Open requests, request is sent in SYN (TCP_FASTOPEN).
+	std::optional<int> fast_open_queue;
+	//! Receive buffer size, set on listener before listen, so window scale is negotiated (SO_RCVBUF).
+	std::optional<int> receive_buffer_size;
+	//! Send buffer size (SO_SNDBUF).
+	std::optional<int> send_buffer_size;
+	//! Send ACKs immediately instead of delayed ones on accepted sockets (TCP_QUICKACK).
+	//! Kernel clears the flag when it leaves quick ack mode, so connection sets it again after every read.
+	bool quick_ack = false;
+	//! Busy poll time of accepted sockets in microseconds (SO_BUSY_POLL).
+	std::optional<int> busy_poll;
+	//! Keepalive probes of accepted sockets (SO_KEEPALIVE, TCP_KEEPIDLE, TCP_KEEPINTVL, TCP_KEEPCNT).
+	std::optional<TcpKeepAlive> keep_alive;
+	//! Listening socket created by caller (e.g. master process), address isn't bound if it is set.
+	int listener_fd = -1;
+	//! Unix socket for hot restart: listener is taken from running server and passed to next one (empty - disabled).
+	std::string handoff_path;
+};
+
+/**
+ * \brief Open acceptor, apply listener options, bind it and start listening.
+ *
+ * Throw boost::system::system_error if option can't be set.
+ */
+void OpenAcceptor(
+	boost::asio::ip::tcp::acceptor& acceptor,
+	const boost::asio::ip::tcp::endpoint& endpoint,
+	const ListenerOptions& options);
+
+/**
+ * \brief Create listening socket with options, it isn't owned by io context (e.g. for passing to other process).
+ */
+[[nodiscard]] int CreateListener(const boost::asio::ip::tcp::endpoint& endpoint, const ListenerOptions& options);
+
+/**
+ * \brief Use listening socket of other process (inherited or handed off), set backlog.
+ *
+ * Options set before bind are kept from original listener.
+ */
+void AssignAcceptor(boost::asio::ip::tcp::acceptor& acceptor, int fd, const ListenerOptions& options);
+
+/**
+ * \brief Apply options of accepted sockets.
+ *
+ * Failed option doesn't prevent connection handling, so first error is returned.
+ */
+boost::system::error_code ApplyAcceptedSocketOptions(
+	boost::asio::ip::tcp::socket& socket,
+	const ListenerOptions& options) noexcept;
+
+/**
+ * \brief Set TCP_QUICKACK on socket again, it isn't permanent.
+ */
+boost::system::error_code RenewQuickAck(boost::asio::ip::tcp::socket& socket) noexcept;
+
+/**
+ * \brief Return connections waiting in accept queue of listener.
+ */
+[[nodiscard]] uint64_t GetAcceptQueueLength(boost::asio::ip::tcp::acceptor& acceptor) noexcept;
+
+/**
+ * \brief Return connections dropped by system because accept queue was full (TcpExt ListenOverflows).
+ */
+[[nodiscard]] uint64_t GetListenOverflows();
+
+} // namespace Http::Server
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+
+namespace Http::Server
+{
+
+/**
+ * \brief Phases of request.
+ */
+enum class RequestPhase
+{
+	//! First bytes of request are read.
+	FirstByte,
+	//! Request line and headers are parsed.
+	HeadersParsed,
+	//! Request is parsed with body.
+	BodyComplete,
+	//! Request is passed to handler.
+	HandlerDispatched,
+	//! First response bytes are queued by handler.
+	HandlerResponded,
+	//! First buffer of response is written into socket.
+	FirstByteWritten,
+	//! Response is written into socket.
+	LastByteWritten,
+};
+
+//! Count of request phases.
+constexpr size_t request_phases_count = static_cast<size_t>(RequestPhase::LastByteWritten) + 1;
+
+/**
+ * \brief Time points of request phases.
+ *
+ * Steady clock is read by vDSO on Linux (TSC without system call), so every request is timed.
+ */
+class RequestTimeline final
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	/**
+	 * \brief Set time of phase to now, return it.
+	 */
+	Clock::time_point Mark(RequestPhase phase) noexcept;
+	/**
+	 * \brief Set time of phase.
+	 */
+	void Mark(RequestPhase phase, Clock::time_point time) noexcept;
+	/**
+	 * \brief Check if phase is reached.
+	 */
+	[[nodiscard]] bool Has(RequestPhase phase) const noexcept;
+	/**
+	 * \brief Return time of phase (epoch if phase isn't reached).
+	 */
+	[[nodiscard]] Clock::time_point Get(RequestPhase phase) const noexcept;
+	/**
+	 * \brief Return time between phases, nullopt if any of them isn't reached.
+	 */
+	[[nodiscard]] std::optional<Clock::duration> GetDuration(RequestPhase from, RequestPhase to) const noexcept;
+	/**
+	 * \brief Forget all phases.
+	 */
+	void Reset() noexcept;
+
+private:
+	//! Time of phases, epoch if phase isn't reached.
+	std::array<Clock::time_point, request_phases_count> phases_{};
+};
+
+/**
+ * \brief W3C trace context of span.
+ */
+struct TraceContext final
+{
+	//! Trace id, shared by all spans of trace.
+	std::array<uint8_t, 16> trace_id{};
+	//! Span id.
+	std::array<uint8_t, 8> span_id{};
+	//! Trace is recorded.
+	bool sampled = false;
+};
+
+/**
+ * \brief Parse traceparent header, nullopt if it is invalid.
+ */
+[[nodiscard]] std::optional<TraceContext> ParseTraceParent(std::string_view value) noexcept;
+
+/**
+ * \brief Format traceparent header, it is passed to downstream services by handler.
+ */
+[[nodiscard]] std::string FormatTraceParent(const TraceContext& context);
+
+/**
+ * \brief Span of sampled request.
+ */
+struct Span final
+{
+	//! Context of span.
+	TraceContext context;
+	//! Span of caller, which passed traceparent.
+	std::optional<std::array<uint8_t, 8>> parent_span_id;
+	//! Method and path.
+	std::string name;
+	//! Response status code.
+	unsigned status_code = 0;
+	//! Connection id.
+	uint64_t connection_id = 0;
+	//! Request phases.
+	RequestTimeline timeline;
+};
+
+/**
+ * \brief Tracing settings.
+ */
+struct TracerOptions final
+{
+	//! Probability of sampling request without traceparent, request with traceparent follows its sampled flag.
+	double sample_rate = 0.01;
+	//! File of exported spans (JSON object per line), opened for appending.
+	std::string output_path;
+	//! Max spans waiting for export, new spans are dropped above it.
+	size_t max_queue_size = 4096;
+};
+
+/**
+ * \brief Sampling tracer: spans are created for sampled requests and written by exporter thread.
+ *
+ * Requests, which aren't sampled, cost only ids generation. Tracer should outlive server.
+ */
+class Tracer final
+{
+public:
+	Tracer(const Tracer&) = delete;
+	Tracer& operator=(const Tracer&) = delete;
+
+	Tracer(Tracer&&) = delete;
+	Tracer& operator=(Tracer&&) = delete;
+
+	explicit Tracer(const TracerOptions& options);
+
+	/**
+	 * \brief Export queued spans and stop.
+	 */
+	~Tracer();
+
+	/**
+	 * \brief Export queued spans and stop exporter, spans passed after it are dropped.
+	 */
+	void Stop();
+
+	/**
+	 * \brief Create context of request span: child of parent or root of new trace.
+	 */
+	[[nodiscard]] TraceContext StartSpan(const std::optional<TraceContext>& parent);
+	/**
+	 * \brief Queue finished span for export.
+	 */
+	void Export(Span span);
+	/**
+	 * \brief Return count of exported spans.
+	 */
+	[[nodiscard]] uint64_t ExportedCount() const noexcept;
+	/**
+	 * \brief Return count of spans dropped because of full queue or write error.
+	 */
+	[[nodiscard]] uint64_t DroppedCount() const noexcept;
+
+private:
+	/**
+	 * \brief Write span as JSON line.
+	 */
+	[[nodiscard]] bool WriteSpan(const Span& span) noexcept;
+
+private:
+	//! Settings.
+	const TracerOptions options_;
+	//! Output file.
+	int output_ = -1;
+	//! Time points of the same moment, steady time of span is converted into unix time.
+	const RequestTimeline::Clock::time_point steady_anchor_;
+	const std::chrono::system_clock::time_point system_anchor_;
+	//! Protect queue and stop flag.
+	std::mutex mutex_;
+	//! Wake up exporter on new span and stop.
+	std::condition_variable condition_;
+	//! Spans waiting for export.
+	std::deque<Span> queue_;
+	//! Tracer is stopped.
+	bool stopped_ = false;
+	//! Exported spans.
+	std::atomic_uint64_t exported_ = 0;
+	//! Dropped spans.
+	std::atomic_uint64_t dropped_ = 0;
+	//! Exporter thread.
+	std::thread thread_;
+};
+
+} // namespace Http::Server
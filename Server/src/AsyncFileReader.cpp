@@ -0,0 +1,128 @@
+#include <CustomServer/AsyncFileReader.hpp>
+
+#include <unistd.h>
+
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+
+namespace Http::Server
+{
+
+namespace
+{
+
+#if defined(BOOST_ASIO_HAS_FILE)
+/**
+ * \brief State of one file read.
+ */
+struct ReadOperation final
+{
+	//! Opened file.
+	boost::asio::random_access_file file;
+	//! File content, read directly into response body storage.
+	std::string content;
+	//! Already read bytes.
+	size_t offset = 0;
+	//! Completion handler.
+	AsyncFileReader::ReadHandler handler;
+};
+
+void ContinueRead(std::shared_ptr<ReadOperation> operation)
+{
+	auto buffer = boost::asio::buffer(
+		operation->content.data() + operation->offset,
+		operation->content.size() - operation->offset);
+	operation->file.async_read_some_at(
+		operation->offset,
+		buffer,
+		[operation](const boost::system::error_code& ec, const size_t bytes_transferred) mutable
+		{
+			operation->offset += bytes_transferred;
+			if (operation->offset == operation->content.size())
+			{
+				operation->handler({}, std::move(operation->content));
+				return;
+			}
+
+			if (ec || bytes_transferred == 0)
+			{
+				// File was truncated after metadata was read.
+				operation->handler(ec ? ec : boost::asio::error::eof, {});
+				return;
+			}
+			ContinueRead(std::move(operation));
+		});
+}
+#endif // defined(BOOST_ASIO_HAS_FILE)
+
+} // namespace
+
+bool AsyncFileReader::IsSupported() noexcept
+{
+#if defined(BOOST_ASIO_HAS_FILE) && defined(BOOST_ASIO_HAS_IO_URING)
+	return true;
+#else
+	return false;
+#endif // defined(BOOST_ASIO_HAS_FILE) && defined(BOOST_ASIO_HAS_IO_URING)
+}
+
+AsyncFileReader::AsyncFileReader()
+	: work_(boost::asio::make_work_guard(io_context_))
+{
+	if (!IsSupported())
+	{
+		throw std::runtime_error("Asynchronous file io isn't supported, build server with HTTP_SERVER_USE_IO_URING");
+	}
+
+	work_thread_ = std::thread{[this]() { io_context_.run(); }};
+}
+
+void AsyncFileReader::AsyncReadFile(const int fd, [[maybe_unused]] const size_t size, ReadHandler handler)
+{
+#if defined(BOOST_ASIO_HAS_FILE)
+	boost::system::error_code ec;
+	boost::asio::random_access_file file(io_context_);
+	file.assign(fd, ec);
+	if (ec)
+	{
+		::close(fd);
+		boost::asio::post(io_context_, [handler = std::move(handler), ec]() { handler(ec, {}); });
+		return;
+	}
+
+	auto operation = std::make_shared<ReadOperation>(ReadOperation{std::move(file), {}, 0, std::move(handler)});
+	if (size == 0)
+	{
+		boost::asio::post(io_context_, [operation]() { operation->handler({}, {}); });
+		return;
+	}
+	operation->content.resize(size);
+	ContinueRead(std::move(operation));
+#else
+	::close(fd);
+	boost::asio::post(
+		io_context_,
+		[handler = std::move(handler)]() { handler(boost::asio::error::operation_not_supported, {}); });
+#endif // defined(BOOST_ASIO_HAS_FILE)
+}
+
+void AsyncFileReader::Stop()
+{
+	if (!work_thread_.joinable())
+	{
+		return;
+	}
+
+	work_.reset();
+	io_context_.stop();
+	work_thread_.join();
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	Stop();
+}
+
+} // namespace Http::Server
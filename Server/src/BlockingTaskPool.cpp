@@ -0,0 +1,129 @@
+#include <CustomServer/BlockingTaskPool.hpp>
+
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+
+namespace Http::Server
+{
+
+BlockingTaskPool::BlockingTaskPool(const size_t thread_count, const size_t max_queue_size)
+	: max_queue_size_(max_queue_size)
+{
+	if (thread_count == 0)
+	{
+		throw std::runtime_error("Thread count should be more than 0 for blocking task pool");
+	}
+
+	work_threads_.reserve(thread_count);
+	for (size_t i = 0; i < thread_count; ++i)
+	{
+		work_threads_.emplace_back([this]() { WorkLoop(); });
+	}
+}
+
+bool BlockingTaskPool::Post(std::function<void()> task)
+{
+	{
+		std::lock_guard lock{mutex_};
+		if (stopped_ || queue_.size() >= max_queue_size_)
+		{
+			++rejected_tasks_;
+			return false;
+		}
+		queue_.push_back(Task{std::move(task), std::chrono::steady_clock::now()});
+	}
+	condition_.notify_one();
+	return true;
+}
+
+BlockingTaskPoolStatistics BlockingTaskPool::GetStatistics() const
+{
+	BlockingTaskPoolStatistics statistics;
+	{
+		std::lock_guard lock{mutex_};
+		statistics.queue_size = queue_.size();
+	}
+	statistics.max_queue_size = max_queue_size_;
+	statistics.completed_tasks = completed_tasks_;
+	statistics.rejected_tasks = rejected_tasks_;
+	statistics.discarded_tasks = discarded_tasks_;
+	statistics.total_wait_time = std::chrono::microseconds{summary_wait_time_};
+	if (statistics.completed_tasks != 0)
+	{
+		statistics.average_wait_time = statistics.total_wait_time / statistics.completed_tasks;
+	}
+	statistics.max_wait_time = std::chrono::microseconds{max_wait_time_};
+	return statistics;
+}
+
+void BlockingTaskPool::Stop()
+{
+	// Tasks are destroyed without lock, they may release requests.
+	std::deque<Task> discarded;
+	{
+		std::lock_guard lock{mutex_};
+		if (stopped_)
+		{
+			return;
+		}
+		stopped_ = true;
+		discarded = std::move(queue_);
+		queue_.clear();
+	}
+	condition_.notify_all();
+
+	if (!discarded.empty())
+	{
+		discarded_tasks_ += discarded.size();
+		std::cerr << "Blocking task pool is stopped, " << discarded.size() << " not started tasks are discarded" << std::endl;
+		discarded.clear();
+	}
+
+	for (auto& thread : work_threads_)
+	{
+		thread.join();
+	}
+}
+
+BlockingTaskPool::~BlockingTaskPool()
+{
+	Stop();
+}
+
+void BlockingTaskPool::WorkLoop()
+{
+	while (true)
+	{
+		Task task;
+		{
+			std::unique_lock lock{mutex_};
+			condition_.wait(lock, [this]() { return stopped_ || !queue_.empty(); });
+			if (stopped_)
+			{
+				return;
+			}
+			task = std::move(queue_.front());
+			queue_.pop_front();
+		}
+
+		const uint64_t wait_time = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - task.queued_at).count();
+		summary_wait_time_ += wait_time;
+		auto max_wait_time = max_wait_time_.load();
+		while (max_wait_time < wait_time && !max_wait_time_.compare_exchange_weak(max_wait_time, wait_time));
+
+		try
+		{
+			task.function();
+		}
+		catch (const std::exception& exc)
+		{
+			std::cerr << "Blocking task failed: " << exc.what() << std::endl;
+		}
+		++completed_tasks_;
+	}
+}
+
+} // namespace Http::Server
@@ -0,0 +1,213 @@
+#include <CustomServer/CompressionStream.hpp>
+
+#include <zlib.h>
+
+#if defined(HTTP_SERVER_HAS_ZSTD)
+#include <zstd.h>
+#endif // defined(HTTP_SERVER_HAS_ZSTD)
+
+#include <array>
+#include <stdexcept>
+#include <string>
+
+
+namespace Http::Server
+{
+
+namespace
+{
+
+//! Compressed data is produced by chunks of this size.
+constexpr size_t output_chunk_size = 16384;
+
+} // namespace
+
+class CompressionStream::Impl
+{
+public:
+	virtual ~Impl() = default;
+
+	virtual void Write(std::string_view input, std::string& output) = 0;
+	virtual void Finish(std::string& output) = 0;
+};
+
+namespace
+{
+
+class ZlibImpl final : public CompressionStream::Impl
+{
+public:
+	ZlibImpl(const ContentEncoding encoding, const int level)
+	{
+		// 15 bits window, +16 means gzip wrapper.
+		const int window_bits = encoding == ContentEncoding::Gzip ? 15 + 16 : 15;
+		if (deflateInit2(&stream_, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		{
+			throw std::runtime_error("Can't initialize zlib stream");
+		}
+	}
+
+	ZlibImpl(const ZlibImpl&) = delete;
+	ZlibImpl& operator=(const ZlibImpl&) = delete;
+
+	void Write(const std::string_view input, std::string& output) override
+	{
+		Process(input, Z_NO_FLUSH, output);
+	}
+
+	void Finish(std::string& output) override
+	{
+		Process({}, Z_FINISH, output);
+	}
+
+	~ZlibImpl() override
+	{
+		deflateEnd(&stream_);
+	}
+
+private:
+	void Process(const std::string_view input, const int flush, std::string& output)
+	{
+		stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+		stream_.avail_in = static_cast<uInt>(input.size());
+		do
+		{
+			stream_.next_out = reinterpret_cast<Bytef*>(chunk_.data());
+			stream_.avail_out = static_cast<uInt>(chunk_.size());
+			const auto result = deflate(&stream_, flush);
+			if (result == Z_STREAM_ERROR)
+			{
+				throw std::runtime_error("Zlib compression error");
+			}
+			output.append(chunk_.data(), chunk_.size() - stream_.avail_out);
+		}
+		while (stream_.avail_out == 0);
+	}
+
+private:
+	//! Zlib state.
+	z_stream stream_{};
+	//! Output chunk.
+	std::array<char, output_chunk_size> chunk_;
+};
+
+#if defined(HTTP_SERVER_HAS_ZSTD)
+class ZstdImpl final : public CompressionStream::Impl
+{
+public:
+	explicit ZstdImpl(const int level)
+		: stream_(ZSTD_createCStream())
+	{
+		if (!stream_ || ZSTD_isError(ZSTD_initCStream(stream_, level)))
+		{
+			ZSTD_freeCStream(stream_);
+			throw std::runtime_error("Can't initialize zstd stream");
+		}
+	}
+
+	ZstdImpl(const ZstdImpl&) = delete;
+	ZstdImpl& operator=(const ZstdImpl&) = delete;
+
+	void Write(const std::string_view input, std::string& output) override
+	{
+		ZSTD_inBuffer in{input.data(), input.size(), 0};
+		while (in.pos < in.size)
+		{
+			ZSTD_outBuffer out{chunk_.data(), chunk_.size(), 0};
+			const auto result = ZSTD_compressStream(stream_, &out, &in);
+			if (ZSTD_isError(result))
+			{
+				throw std::runtime_error("Zstd compression error");
+			}
+			output.append(chunk_.data(), out.pos);
+		}
+	}
+
+	void Finish(std::string& output) override
+	{
+		size_t remaining = 0;
+		do
+		{
+			ZSTD_outBuffer out{chunk_.data(), chunk_.size(), 0};
+			remaining = ZSTD_endStream(stream_, &out);
+			if (ZSTD_isError(remaining))
+			{
+				throw std::runtime_error("Zstd compression error");
+			}
+			output.append(chunk_.data(), out.pos);
+		}
+		while (remaining != 0);
+	}
+
+	~ZstdImpl() override
+	{
+		ZSTD_freeCStream(stream_);
+	}
+
+private:
+	//! Zstd state.
+	ZSTD_CStream* stream_ = nullptr;
+	//! Output chunk.
+	std::array<char, output_chunk_size> chunk_;
+};
+#endif // defined(HTTP_SERVER_HAS_ZSTD)
+
+} // namespace
+
+bool CompressionStream::IsSupported(const ContentEncoding encoding) noexcept
+{
+	switch (encoding)
+	{
+	case ContentEncoding::Gzip:
+	case ContentEncoding::Deflate:
+		return true;
+#if defined(HTTP_SERVER_HAS_ZSTD)
+	case ContentEncoding::Zstd:
+		return true;
+#endif // defined(HTTP_SERVER_HAS_ZSTD)
+	default:
+		return false;
+	}
+	return false;
+}
+
+CompressionStream::CompressionStream(CompressionStream&&) noexcept = default;
+CompressionStream& CompressionStream::operator=(CompressionStream&&) noexcept = default;
+
+CompressionStream::CompressionStream(const ContentEncoding encoding, const int level)
+	: encoding_(encoding)
+{
+	switch (encoding_)
+	{
+	case ContentEncoding::Gzip:
+	case ContentEncoding::Deflate:
+		impl_ = std::make_unique<ZlibImpl>(encoding_, level);
+		break;
+#if defined(HTTP_SERVER_HAS_ZSTD)
+	case ContentEncoding::Zstd:
+		impl_ = std::make_unique<ZstdImpl>(level);
+		break;
+#endif // defined(HTTP_SERVER_HAS_ZSTD)
+	default:
+		throw std::runtime_error("Unsupported content coding " + std::string{ConvertToString(encoding_)});
+	}
+}
+
+void CompressionStream::Write(const std::string_view input, std::string& output)
+{
+	impl_->Write(input, output);
+}
+
+void CompressionStream::Finish(std::string& output)
+{
+	impl_->Finish(output);
+}
+
+ContentEncoding CompressionStream::GetEncoding() const noexcept
+{
+	return encoding_;
+}
+
+CompressionStream::~CompressionStream() = default;
+
+} // namespace Http::Server
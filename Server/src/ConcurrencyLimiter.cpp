@@ -0,0 +1,198 @@
+#include <CustomServer/ConcurrencyLimiter.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+
+namespace Http::Server
+{
+
+ConcurrencyLimiter::ConcurrencyLimiter(const ConcurrencyLimiterOptions& options)
+	: options_(options)
+	, limit_(std::clamp(options_.initial_limit, options_.min_limit, options_.max_limit))
+	, estimated_limit_(limit_)
+	, window_start_(Clock::now())
+{
+	if (options_.min_limit == 0 || options_.min_limit > options_.max_limit)
+	{
+		throw std::runtime_error("Incorrect concurrency limits");
+	}
+}
+
+ConcurrencyLimiter::Admission ConcurrencyLimiter::Acquire(WaitHandler handler)
+{
+	// Queued requests go first, so new request doesn't overtake them.
+	if (waiters_count_ == 0 && TryTakeSlot())
+	{
+		return Admission::Admitted;
+	}
+
+	if (options_.max_queue_size != 0 && handler)
+	{
+		std::lock_guard lock{waiters_mutex_};
+		// Slot could be released while request was checked.
+		if (waiters_.empty() && TryTakeSlot())
+		{
+			return Admission::Admitted;
+		}
+		if (waiters_.size() < options_.max_queue_size)
+		{
+			waiters_.push_back(Waiter{std::move(handler), Clock::now()});
+			++waiters_count_;
+			return Admission::Queued;
+		}
+	}
+
+	++rejected_;
+	return Admission::Rejected;
+}
+
+void ConcurrencyLimiter::Release(const std::optional<Clock::duration> latency)
+{
+	const auto in_flight = in_flight_--;
+	const auto now = Clock::now();
+	if (latency)
+	{
+		// Statistics is approximate, so sample is skipped instead of waiting for other thread.
+		std::unique_lock lock{samples_mutex_, std::try_to_lock};
+		if (lock)
+		{
+			window_max_in_flight_ = std::max(window_max_in_flight_, in_flight);
+			AddSample(*latency, now);
+		}
+	}
+
+	// Limit could be increased by sample, so several waiters may be admitted.
+	ProcessWaiters(now);
+}
+
+void ConcurrencyLimiter::ExpireWaiters()
+{
+	ProcessWaiters(Clock::now());
+}
+
+unsigned ConcurrencyLimiter::GetLimit() const noexcept
+{
+	return limit_;
+}
+
+unsigned ConcurrencyLimiter::GetInFlight() const noexcept
+{
+	return in_flight_;
+}
+
+uint64_t ConcurrencyLimiter::RejectedCount() const noexcept
+{
+	return rejected_;
+}
+
+std::chrono::milliseconds ConcurrencyLimiter::GetMaxWait() const noexcept
+{
+	return options_.max_wait;
+}
+
+void ConcurrencyLimiter::ProcessWaiters(const Clock::time_point now)
+{
+	if (waiters_count_ == 0)
+	{
+		return;
+	}
+
+	std::vector<WaitHandler> expired;
+	std::vector<WaitHandler> admitted;
+	{
+		std::lock_guard lock{waiters_mutex_};
+		while (!waiters_.empty())
+		{
+			if (now - waiters_.front().enqueued >= options_.max_wait)
+			{
+				expired.push_back(std::move(waiters_.front().handler));
+			}
+			else if (TryTakeSlot())
+			{
+				admitted.push_back(std::move(waiters_.front().handler));
+			}
+			else
+			{
+				break;
+			}
+			waiters_.pop_front();
+			--waiters_count_;
+		}
+	}
+
+	rejected_ += expired.size();
+	for (const auto& handler : expired)
+	{
+		handler(false);
+	}
+	for (const auto& handler : admitted)
+	{
+		handler(true);
+	}
+}
+
+bool ConcurrencyLimiter::TryTakeSlot() noexcept
+{
+	auto in_flight = in_flight_.load();
+	while (in_flight < limit_)
+	{
+		if (in_flight_.compare_exchange_weak(in_flight, in_flight + 1))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void ConcurrencyLimiter::AddSample(const Clock::duration latency, const Clock::time_point now)
+{
+	window_latency_sum_ += static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+	++window_samples_;
+	if (window_samples_ < options_.min_window_samples || now - window_start_ < options_.window)
+	{
+		return;
+	}
+
+	const auto short_latency = std::max(window_latency_sum_ / window_samples_, 1.0);
+	const auto max_in_flight = window_max_in_flight_;
+	window_latency_sum_ = 0;
+	window_samples_ = 0;
+	window_max_in_flight_ = 0;
+	window_start_ = now;
+
+	if (long_latency_ == 0)
+	{
+		long_latency_ = short_latency;
+	}
+	else
+	{
+		const auto factor = 1.0 / options_.long_window;
+		long_latency_ = long_latency_ * (1 - factor) + short_latency * factor;
+	}
+	// Long latency follows steady latency decrease faster, otherwise limit stays low after load peak.
+	if (long_latency_ / short_latency > 2)
+	{
+		long_latency_ *= 0.95;
+	}
+
+	// Limit isn't used completely, so latency doesn't depend on it.
+	if (max_in_flight < estimated_limit_ / 2)
+	{
+		return;
+	}
+
+	const auto gradient = std::clamp(options_.tolerance * long_latency_ / short_latency, 0.5, 1.0);
+	const auto queue_size = std::sqrt(estimated_limit_);
+	const auto new_limit = estimated_limit_ * gradient + queue_size;
+	estimated_limit_ = std::clamp(
+		estimated_limit_ * (1 - options_.smoothing) + new_limit * options_.smoothing,
+		static_cast<double>(options_.min_limit),
+		static_cast<double>(options_.max_limit));
+	limit_ = static_cast<unsigned>(estimated_limit_);
+}
+
+} // namespace Http::Server
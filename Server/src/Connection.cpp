@@ -3,9 +3,14 @@
 #include <CustomServer/ServerState.hpp>
 #include <CustomServer/HttpRequestConnection.hpp>
 #include <CustomServer/RequestHandler.hpp>
+#include <CustomServer/SocketOptions.hpp>
 
 #include <Http/HttpResponse.hpp>
 
+#include <sys/sendfile.h>
+
+#include <algorithm>
+#include <cerrno>
 #include <utility>
 #include <string>
 #include <string_view>
@@ -16,14 +21,25 @@
 namespace Http::Server
 {
 
+namespace
+{
+
+uint64_t ToMicroseconds(const std::chrono::steady_clock::duration duration) noexcept
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+}
+
+} // namespace
+
 std::shared_ptr<Connection> Connection::CreateHttpConnection(
 	State& server_state,
 	boost::asio::io_context& io_context,
-	std::function<void(HttpRequestConnectionUPtr)> request_handler,
-	const std::chrono::seconds timeout)
+	RequestHandlerRef request_handler,
+	const ConnectionOptions& options,
+	std::atomic_uint* executor_connections)
 {
 	return std::shared_ptr<Connection>{
-		new Connection{server_state, io_context, std::move(request_handler), timeout}};
+		new Connection{server_state, io_context, request_handler, options, executor_connections}};
 }
 
 boost::asio::ip::tcp::socket& Connection::GetSocket()
@@ -39,8 +55,8 @@ void Connection::Start()
 		return;
 	}
 
-	connection_started_ = std::chrono::steady_clock::now();
-	static uint64_t connection_count = 0;
+	// Connections are started by many io threads.
+	static std::atomic_uint64_t connection_count = 0;
 	connection_id_ = ++connection_count;
 	SetTimeoutTimer();
 	DoRead();
@@ -48,57 +64,187 @@ void Connection::Start()
 
 bool Connection::ConnectionIsAvailable() const
 {
-	return !server_state_.IsStopped() && !canceled_;
+	// Stopped server still finishes started responses.
+	return !canceled_;
 }
 
-bool Connection::Write(std::string buffer, const bool keep_alive)
+bool Connection::Write(OutputData data, const WriteCompletion completion, WriteHandler handler)
 {
-	if (!can_write_data_ || !ConnectionIsAvailable())
+	if (!ConnectionIsAvailable())
+	{
+		return false;
+	}
+	// Response is finished by last buffer, next buffers belong to next request.
+	const auto can_write = completion == WriteCompletion::None ? can_write_data_.load() : can_write_data_.exchange(false);
+	if (!can_write)
 	{
 		return false;
 	}
 
+	// Bytes are counted before post, so producer sees backpressure immediately (file regions aren't held in memory).
+	const auto size = GetMemoryData(data).size();
+	const auto queued_bytes = queued_bytes_.fetch_add(size) + size;
+	server_state_.AddBufferedBytes(size);
+	if (queued_bytes > options_.write_high_watermark)
+	{
+		write_queue_full_ = true;
+	}
+
 	strand_.post(
-		[this, self = shared_from_this(), response = std::move(buffer), keep_alive]() mutable
+		[this, self = shared_from_this(), data = std::move(data), completion, handler = std::move(handler)]() mutable
 		{
-			DoWrite(std::move(response), keep_alive);
+			DoWrite(std::move(data), completion, std::move(handler));
 		});
 	return true;
 }
 
+bool Connection::Write(const HttpRequest& request, const HttpResponse& response)
+{
+	auto keep_alive = false;
+	auto head = PackResponseHead(request, response, keep_alive);
+	const auto completion = keep_alive ? WriteCompletion::KeepAlive : WriteCompletion::Close;
+	// Response to HEAD has headers of GET response, but without body.
+	if (request.GetMethodType() == HttpMethodType::Head || !StatusCodeAllowsBody(response.GetStatusCode()))
+	{
+		return Write(std::move(head), completion);
+	}
+
+	const auto& body = response.GetHttpBody();
+	if (const auto* string = std::get_if<std::string>(&body))
+	{
+		head += *string;
+		return Write(std::move(head), completion);
+	}
+	if (const auto* buffer = std::get_if<SharedBuffer>(&body))
+	{
+		return Write(std::move(head), WriteCompletion::None) && Write(*buffer, completion);
+	}
+	if (const auto* region = std::get_if<FileRegion>(&body))
+	{
+		return Write(std::move(head), WriteCompletion::None) && Write(*region, completion);
+	}
+	throw std::runtime_error("Generated body should be sent by stream");
+}
+
+std::string Connection::PackResponseHead(
+	const HttpRequest& request,
+	const HttpResponse& response,
+	bool& keep_alive) const
+{
+	const auto& response_headers = response.GetHeaders();
+	const auto connection_header = response_headers.find("Connection");
+	const auto response_closes = connection_header != response_headers.cend()
+		&& ContainsToken(connection_header->second, "close");
+	const auto limit_reached = options_.max_requests != 0 && requests_count_ >= options_.max_requests;
+	server_state_.GetMetrics().AddResponse(static_cast<unsigned>(response.GetStatusCode()));
+	response_status_code_ = static_cast<unsigned>(response.GetStatusCode());
+	keep_alive = request.IsKeepAlive() && !response_closes && !limit_reached && ConnectionIsAvailable()
+		&& !server_state_.IsStopped();
+
+	std::string headers;
+	if (connection_header == response_headers.cend())
+	{
+		const auto& version = request.GetHTTPVersion();
+		if (!keep_alive)
+		{
+			headers += "Connection: close\r\n";
+		}
+		else if (version.major == 1 && version.minor == 0)
+		{
+			headers += "Connection: keep-alive\r\n";
+		}
+	}
+	if (keep_alive && (options_.timeout.count() != 0 || options_.max_requests != 0))
+	{
+		headers += "Keep-Alive: ";
+		if (options_.timeout.count() != 0)
+		{
+			headers += "timeout=" + std::to_string(options_.timeout.count());
+		}
+		if (options_.max_requests != 0)
+		{
+			headers += options_.timeout.count() != 0 ? ", max=" : "max=";
+			headers += std::to_string(options_.max_requests - requests_count_);
+		}
+		headers += "\r\n";
+	}
+	return response.PackHeadersToString(headers);
+}
+
+size_t Connection::GetQueuedBytes() const noexcept
+{
+	return queued_bytes_;
+}
+
+bool Connection::IsWriteQueueFull() const noexcept
+{
+	return write_queue_full_;
+}
+
+void Connection::Post(std::function<void()> task)
+{
+	strand_.post(
+		[self = shared_from_this(), task = std::move(task)]()
+		{
+			task();
+		});
+}
+
+void Connection::Drain()
+{
+	strand_.post(
+		[this, self = shared_from_this()]()
+		{
+			draining_ = true;
+			CloseIfIdle();
+		});
+}
+
 Connection::~Connection()
 {
+	// Release load of operations, which were dropped without completion (e.g. io context is stopped).
+	server_state_.RemoveBufferedBytes(queued_bytes_);
+	ReleaseConcurrencySlot(false);
+	for (; requests_in_flight_ != 0; --requests_in_flight_)
+	{
+		server_state_.RemoveRequest();
+	}
+	if (executor_connections_)
+	{
+		--*executor_connections_;
+	}
 	server_state_.RemoveConnection();
 }
 Connection::Connection(
 	State& server_state,
 	boost::asio::io_context& io_context,
-	std::function<void(HttpRequestConnectionUPtr)> request_handler,
-	const std::chrono::seconds timeout)
+	RequestHandlerRef request_handler,
+	const ConnectionOptions& options,
+	std::atomic_uint* executor_connections)
 	: server_state_(server_state)
 	, io_context_(io_context)
-	, request_handler_(std::move(request_handler))
+	, request_handler_(request_handler)
 	, socket_(io_context_)
 	, strand_(io_context_)
-	, timeout_(timeout)
+	, options_(options)
+	, executor_connections_(executor_connections)
 {
-	if (!request_handler_)
+	server_state_.AddConnection();
+	if (executor_connections_)
 	{
-		throw std::runtime_error("Request handler isn't set");
+		++*executor_connections_;
 	}
-
-	server_state_.AddConnection();
 }
 
 void Connection::SetTimeoutTimer()
 {
-	if (timeout_ == std::chrono::seconds{0})
+	if (options_.timeout == std::chrono::seconds{0})
 	{
 		return;
 	}
 
 	timeout_timer_.emplace(io_context_);
-	timeout_timer_->expires_after(timeout_);
+	timeout_timer_->expires_after(options_.timeout);
 	DoSetTimerHandler();
 }
 
@@ -110,17 +256,50 @@ void Connection::CancelTimeoutTimer()
 	}
 }
 
+void Connection::RestartTimeoutTimer()
+{
+	// Timeout is idle time, so it starts again after every progress.
+	if (timeout_timer_)
+	{
+		timeout_timer_->expires_after(options_.timeout);
+		DoSetTimerHandler();
+	}
+}
+
 void Connection::DoContinueSession()
 {
 	strand_.post(
 		[this, self = shared_from_this()]()
 		{
 			request_parser_ = HttpRequestParser{};
-			response_.clear();
+			request_admitted_ = false;
+			// Response was packed before server stop, so it allowed next request.
+			if (server_state_.IsStopped())
+			{
+				draining_ = true;
+				CloseIfIdle();
+				return;
+			}
+			RestartTimeoutTimer();
 			DoRead();
 		});
 }
 
+void Connection::CloseIfIdle()
+{
+	// Connection without request in flight is closed, even if it hasn't served any request (e.g. preconnect).
+	if (!draining_ || canceled_ || request_admitted_ || !write_queue_.empty())
+	{
+		return;
+	}
+
+	canceled_ = true;
+	CancelTimeoutTimer();
+	boost::system::error_code ec;
+	socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+	socket_.close(ec);
+}
+
 void Connection::DoSetTimerHandler()
 {
 	if (!timeout_timer_)
@@ -138,6 +317,7 @@ void Connection::DoSetTimerHandler()
 
 			}
 			canceled_ = true;
+			server_state_.AddError(ConnectionError::Timeout);
 
 			std::cout << "Stop connection " << connection_id_ << " because of timeout \n";
 
@@ -157,72 +337,554 @@ void Connection::DoRead()
 			if (ec)
 			{
 				CancelTimeoutTimer();
+				// Closing by client or by server isn't error.
+				if (ec != boost::asio::error::eof && ec != boost::asio::error::operation_aborted)
+				{
+					server_state_.AddError(ConnectionError::Read);
+				}
 				std::cerr << "Can't read data for connection " << connection_id_ << ":" << ec.message() << std::endl;
 				return;
 			}
+			server_state_.AddBytesReceived(bytes_transferred);
+			// Kernel returns to delayed ACKs after quick ack mode, so flag is renewed for next segments.
+			if (options_.quick_ack)
+			{
+				RenewQuickAck(socket_);
+			}
+
+			// Load is checked on first bytes of request, before parser allocates anything.
+			if (!request_admitted_)
+			{
+				timeline_.Reset();
+				timeline_.Mark(RequestPhase::FirstByte);
+				request_bytes_ = 0;
+				trace_context_.reset();
+				span_.reset();
+				// Scrape is exempt from limits, its request line is expected in first read.
+				if (IsMetricsRequestLine({buffer_.data(), bytes_transferred}))
+				{
+					server_state_.AddRequest();
+				}
+				else if (!server_state_.TryAddRequest())
+				{
+					server_state_.GetMetrics().AddResponse(static_cast<unsigned>(StatusCode::ServiceUnavailable));
+					response_status_code_ = static_cast<unsigned>(StatusCode::ServiceUnavailable);
+					can_write_data_ = true;
+					if (!Write(server_state_.GetOverloadResponse(), WriteCompletion::Close))
+					{
+						std::cerr << "Can't answer overloaded request for connection " << connection_id_ << std::endl;
+					}
+					return;
+				}
+				request_admitted_ = true;
+				if (requests_in_flight_++ == 0)
+				{
+					requests_work_.emplace(io_context_.get_executor());
+				}
+			}
 
+			request_bytes_ += bytes_transferred;
 			const auto result = request_parser_.Parse(buffer_.data(), buffer_.data() + bytes_transferred);
+			// Phases are marked once per read, so their precision is time of reading one buffer.
+			if (!timeline_.Has(RequestPhase::HeadersParsed) && request_parser_.IsHeadersParsed())
+			{
+				timeline_.Mark(RequestPhase::HeadersParsed);
+			}
 			if (result == ParsingResult::InProgress)
 			{
 				DoRead();
 				return;
 			}
 
+			timeline_.Mark(RequestPhase::BodyComplete);
+			auto& metrics = server_state_.GetMetrics();
+			metrics.Record(
+				Metric::ParseTime,
+				ToMicroseconds(*timeline_.GetDuration(RequestPhase::FirstByte, RequestPhase::BodyComplete)));
+			metrics.Record(Metric::RequestSize, request_bytes_);
+
 			can_write_data_ = true;
 
-			if (result != ParsingResult::Ok)
+			auto http_request = result == ParsingResult::Ok ? request_parser_.PopHttpRequest() : std::nullopt;
+			if (!http_request)
 			{
-				DoWrite(StockResponse(StatusCode::BadRequest).PackToString());
+				server_state_.AddError(ConnectionError::BadRequest);
+				metrics.AddResponse(static_cast<unsigned>(StatusCode::BadRequest));
+				response_status_code_ = static_cast<unsigned>(StatusCode::BadRequest);
+				const auto response = StockResponse(StatusCode::BadRequest);
+				if (!Write(response.PackHeadersToString("Connection: close\r\n") + response.GetBody(), WriteCompletion::Close))
+				{
+					std::cerr << "Can't answer bad request for connection " << connection_id_ << std::endl;
+				}
 				return;
 			}
+			++requests_count_;
 
-			auto http_request = request_parser_.PopHttpRequest();
-			if (!http_request)
+			if (options_.tracer)
 			{
-				DoWrite(StockResponse(StatusCode::BadRequest).PackToString());
-				return;
+				StartTrace(*http_request);
 			}
-
-			request_handler_(
-				std::make_unique<HttpRequestConnection>(
-					std::move(*http_request),
-					shared_from_this()));
+			pending_request_ = std::move(*http_request);
+			AdmitRequest();
 		}));
 }
 
-void Connection::DoWrite(std::string response, const bool keep_alive)
+void Connection::AdmitRequest()
+{
+	auto* concurrency_limiter = server_state_.GetConcurrencyLimiter();
+	if (!concurrency_limiter || IsMetricsRequest(*pending_request_))
+	{
+		DispatchRequest();
+		return;
+	}
+
+	const auto admission = concurrency_limiter->Acquire(
+		[this, self = shared_from_this()](const bool admitted)
+		{
+			// Slot is released by other connection, so request continues in own context.
+			strand_.post(
+				[this, self, admitted]()
+				{
+					admission_timer_.reset();
+					if (!admitted)
+					{
+						RejectRequest();
+						return;
+					}
+					limited_request_started_ = ConcurrencyLimiter::Clock::now();
+					DispatchRequest();
+				});
+		});
+	switch (admission)
+	{
+	case ConcurrencyLimiter::Admission::Admitted:
+		limited_request_started_ = ConcurrencyLimiter::Clock::now();
+		DispatchRequest();
+		break;
+	case ConcurrencyLimiter::Admission::Queued:
+		// Waiter expires after max wait even if no slot is released meanwhile.
+		admission_timer_.emplace(io_context_);
+		admission_timer_->expires_after(concurrency_limiter->GetMaxWait());
+		admission_timer_->async_wait(boost::asio::bind_executor(strand_,
+			[concurrency_limiter, self = shared_from_this()](const boost::system::error_code& ec)
+			{
+				if (!ec)
+				{
+					concurrency_limiter->ExpireWaiters();
+				}
+			}));
+		break;
+	case ConcurrencyLimiter::Admission::Rejected:
+		RejectRequest();
+		break;
+	}
+}
+
+void Connection::DispatchRequest()
+{
+	auto http_request = std::move(*pending_request_);
+	pending_request_.reset();
+	timeline_.Mark(RequestPhase::HandlerDispatched);
+	if (IsMetricsRequest(http_request))
+	{
+		SendMetrics(std::move(http_request));
+		return;
+	}
+	auto request = MakeHttpRequest(std::move(http_request));
+	request->trace_context_ = trace_context_;
+	request_handler_(std::move(request));
+}
+
+void Connection::RejectRequest()
+{
+	pending_request_.reset();
+	server_state_.GetMetrics().AddResponse(static_cast<unsigned>(StatusCode::ServiceUnavailable));
+	response_status_code_ = static_cast<unsigned>(StatusCode::ServiceUnavailable);
+	if (!Write(server_state_.GetOverloadResponse(), WriteCompletion::Close))
+	{
+		std::cerr << "Can't answer overloaded request for connection " << connection_id_ << std::endl;
+	}
+}
+
+bool Connection::IsMetricsRequestLine(const std::string_view data) const noexcept
+{
+	constexpr std::string_view method = "GET ";
+	const auto& path = options_.metrics_path;
+	if (path.empty()
+		|| data.size() <= method.size() + path.size()
+		|| data.substr(0, method.size()) != method
+		|| data.substr(method.size(), path.size()) != path)
+	{
+		return false;
+	}
+	const auto next = data[method.size() + path.size()];
+	return next == ' ' || next == '?';
+}
+
+bool Connection::IsMetricsRequest(const HttpRequest& http_request) const noexcept
+{
+	return !options_.metrics_path.empty()
+		&& http_request.GetMethodType() == HttpMethodType::Get
+		&& http_request.GetUriView().GetPath() == options_.metrics_path;
+}
+
+void Connection::SendMetrics(HttpRequest http_request)
 {
-	bool writing_data = true;
+	// Shards are merged by io thread, scrape is rare and doesn't wait for locks.
+	HttpResponse response{
+		StatusCode::Ok,
+		{{"Content-Type", "text/plain; version=0.0.4"}},
+		FormatPrometheusMetrics(server_state_)};
+	if (!MakeHttpRequest(std::move(http_request))->Send(response))
+	{
+		std::cerr << "Can't answer metrics request for connection " << connection_id_ << std::endl;
+	}
+}
+
+void Connection::StartTrace(const HttpRequest& http_request)
+{
+	const auto& headers = http_request.GetHeaders();
+	const auto traceparent = headers.find("traceparent");
+	const auto parent = traceparent != headers.cend() ? ParseTraceParent(traceparent->second) : std::nullopt;
+	trace_context_ = options_.tracer->StartSpan(parent);
+	if (!trace_context_->sampled)
+	{
+		return;
+	}
 
-	if (!can_write_data_.compare_exchange_strong(writing_data, false) || server_state_.IsStopped())
+	span_ = std::make_unique<Span>();
+	span_->context = *trace_context_;
+	if (parent)
+	{
+		span_->parent_span_id = parent->span_id;
+	}
+	span_->name = ConvertToString(http_request.GetMethodType());
+	span_->name += ' ';
+	span_->name += http_request.GetUriView().GetPath();
+	span_->connection_id = connection_id_;
+}
+
+void Connection::ReleaseConcurrencySlot(const bool completed) noexcept
+{
+	if (!limited_request_started_)
 	{
 		return;
 	}
 
-	std::swap(response, response_);
+	const auto latency = ConcurrencyLimiter::Clock::now() - *limited_request_started_;
+	limited_request_started_.reset();
+	server_state_.GetConcurrencyLimiter()->Release(
+		completed ? std::optional<ConcurrencyLimiter::Clock::duration>{latency} : std::nullopt);
+}
 
-	socket_.async_send(
-		boost::asio::buffer(response_),
+void Connection::DoWrite(OutputData data, const WriteCompletion completion, WriteHandler handler)
+{
+	if (canceled_)
+	{
+		ReleaseQueuedBytes(GetMemoryData(data).size());
+		if (completion != WriteCompletion::None)
+		{
+			ReleaseConcurrencySlot(false);
+			if (request_admitted_)
+			{
+				FinishRequest();
+			}
+		}
+		if (handler)
+		{
+			handler(boost::asio::error::operation_aborted);
+		}
+		return;
+	}
+
+	// Latency of handler is measured up to its response, socket speed doesn't affect concurrency limit.
+	if (completion != WriteCompletion::None)
+	{
+		ReleaseConcurrencySlot(true);
+	}
+
+	if (!timeline_.Has(RequestPhase::HandlerResponded))
+	{
+		timeline_.Mark(RequestPhase::HandlerResponded);
+		if (const auto handler_time = timeline_.GetDuration(RequestPhase::HandlerDispatched, RequestPhase::HandlerResponded))
+		{
+			server_state_.GetMetrics().Record(Metric::HandlerTime, ToMicroseconds(*handler_time));
+		}
+	}
+	const auto* region = std::get_if<FileRegion>(&data);
+	response_bytes_ += region ? region->size : GetMemoryData(data).size();
+
+	// Response is finished before next request is read, so admission flag still belongs to its request.
+	OutputBuffer output_buffer{std::move(data), completion, std::move(handler), false, {}, 0, {}};
+	if (completion != WriteCompletion::None)
+	{
+		output_buffer.finishes_request = request_admitted_;
+		output_buffer.timeline = timeline_;
+		output_buffer.response_bytes = std::exchange(response_bytes_, 0);
+		if (span_)
+		{
+			span_->status_code = response_status_code_;
+			output_buffer.span = std::move(span_);
+		}
+		timeline_.Reset();
+	}
+	write_queue_.push_back(std::move(output_buffer));
+
+	// Next request is read while response is written, unless too much data is queued.
+	if (completion == WriteCompletion::KeepAlive)
+	{
+		if (write_queue_full_)
+		{
+			read_paused_ = true;
+		}
+		else
+		{
+			DoContinueSession();
+		}
+	}
+	DoFlush();
+}
+
+void Connection::DoFlush()
+{
+	if (buffers_in_flight_ != 0 || write_queue_.empty())
+	{
+		return;
+	}
+
+	if (std::holds_alternative<FileRegion>(write_queue_.front().data))
+	{
+		buffers_in_flight_ = 1;
+		DoSendFile();
+		return;
+	}
+
+	// Queued memory buffers up to first file region are sent by one gathered write, shared buffers aren't copied.
+	write_buffers_.clear();
+	for (const auto& output_buffer : write_queue_)
+	{
+		if (std::holds_alternative<FileRegion>(output_buffer.data))
+		{
+			break;
+		}
+		const auto data = GetMemoryData(output_buffer.data);
+		write_buffers_.push_back(boost::asio::buffer(data.data(), data.size()));
+	}
+	buffers_in_flight_ = write_buffers_.size();
+
+	boost::asio::async_write(
+		socket_,
+		write_buffers_,
 		boost::asio::bind_executor(strand_,
-		[this, self = shared_from_this(), keep_alive]
-		(boost::system::error_code ec, size_t)
+		[this, self = shared_from_this()]
+		(boost::system::error_code ec, size_t bytes_transferred)
 		{
-			std::cout << "Finish request " << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - connection_started_).count() << "micros" << std::endl;
-			if (ec)
+			server_state_.AddBytesSent(bytes_transferred);
+			CompleteWrite(ec, bytes_transferred);
+		}));
+}
+
+void Connection::DoSendFile()
+{
+	const auto& region = std::get<FileRegion>(write_queue_.front().data);
+
+	boost::system::error_code ec;
+	socket_.native_non_blocking(true, ec);
+	while (!ec && sent_file_bytes_ < region.size)
+	{
+		auto offset = static_cast<off_t>(region.offset + sent_file_bytes_);
+		const auto sent = ::sendfile(
+			socket_.native_handle(),
+			region.file->Get(),
+			&offset,
+			static_cast<size_t>(std::min<uint64_t>(region.size - sent_file_bytes_, max_sendfile_size)));
+		if (sent > 0)
+		{
+			sent_file_bytes_ += static_cast<uint64_t>(sent);
+			server_state_.AddBytesSent(static_cast<size_t>(sent));
+			continue;
+		}
+		if (sent < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			socket_.async_wait(
+				boost::asio::ip::tcp::socket::wait_write,
+				boost::asio::bind_executor(strand_,
+				[this, self = shared_from_this()](const boost::system::error_code& wait_ec)
+				{
+					if (wait_ec)
+					{
+						sent_file_bytes_ = 0;
+						CompleteWrite(wait_ec, 0);
+						return;
+					}
+					DoSendFile();
+				}));
+			return;
+		}
+		// Zero bytes are sent if file was truncated after response was created.
+		ec = sent == 0
+			? boost::system::error_code{boost::asio::error::eof}
+			: boost::system::error_code{errno, boost::system::system_category()};
+	}
+
+	sent_file_bytes_ = 0;
+	CompleteWrite(ec, 0);
+}
+
+void Connection::CompleteWrite(const boost::system::error_code& ec, const size_t memory_bytes)
+{
+	if (ec)
+	{
+		if (ec != boost::asio::error::operation_aborted)
+		{
+			server_state_.AddError(ConnectionError::Write);
+		}
+		std::cerr << "Can't send data for connection " << connection_id_ << ":" << ec.message() << std::endl;
+		canceled_ = true;
+		CancelTimeoutTimer();
+		// Nothing else can be written, so all waiting producers are notified.
+		auto write_queue = std::move(write_queue_);
+		write_queue_.clear();
+		for (const auto& output_buffer : write_queue)
+		{
+			ReleaseQueuedBytes(GetMemoryData(output_buffer.data).size());
+			if (output_buffer.finishes_request)
 			{
-				std::cerr << "Can't send data for connection " << connection_id_ << ":" << ec.message() << std::endl;
-				CancelTimeoutTimer();
-				return;
+				FinishRequest();
 			}
+			if (output_buffer.handler)
+			{
+				output_buffer.handler(ec);
+			}
+		}
+		return;
+	}
 
-			if (keep_alive)
+	auto close = false;
+	const auto now = RequestTimeline::Clock::now();
+	for (; buffers_in_flight_ != 0; --buffers_in_flight_)
+	{
+		auto output_buffer = std::move(write_queue_.front());
+		write_queue_.pop_front();
+		// Buffers are written in order, so buffer after last one of response starts next response.
+		if (response_first_written_ == RequestTimeline::Clock::time_point{})
+		{
+			response_first_written_ = now;
+		}
+		if (output_buffer.finishes_request)
+		{
+			FinishRequest();
+		}
+		if (output_buffer.completion != WriteCompletion::None)
+		{
+			auto& timeline = output_buffer.timeline;
+			timeline.Mark(RequestPhase::FirstByteWritten, std::exchange(response_first_written_, {}));
+			timeline.Mark(RequestPhase::LastByteWritten, now);
+			auto& metrics = server_state_.GetMetrics();
+			if (const auto latency = timeline.GetDuration(RequestPhase::FirstByte, RequestPhase::LastByteWritten))
 			{
-				DoContinueSession();
-				return;
+				metrics.Record(Metric::RequestLatency, ToMicroseconds(*latency));
+			}
+			if (const auto write_time = timeline.GetDuration(RequestPhase::HandlerResponded, RequestPhase::LastByteWritten))
+			{
+				metrics.Record(Metric::WriteTime, ToMicroseconds(*write_time));
 			}
+			metrics.Record(Metric::ResponseSize, output_buffer.response_bytes);
+			if (output_buffer.span && options_.tracer)
+			{
+				output_buffer.span->timeline = timeline;
+				options_.tracer->Export(std::move(*output_buffer.span));
+			}
+		}
+		close = close || output_buffer.completion == WriteCompletion::Close;
+		if (output_buffer.handler)
+		{
+			output_buffer.handler({});
+		}
+	}
+
+	const auto queued_bytes = ReleaseQueuedBytes(memory_bytes);
+	if (close)
+	{
+		CancelTimeoutTimer();
+		boost::system::error_code shutdown_ec;
+		socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_send, shutdown_ec);
+		return;
+	}
 
-			CancelTimeoutTimer();
-      }));
+	if (write_queue_.empty())
+	{
+		CloseIfIdle();
+		if (canceled_)
+		{
+			return;
+		}
+	}
+
+	RestartTimeoutTimer();
+	if (write_queue_full_ && queued_bytes <= options_.write_low_watermark)
+	{
+		write_queue_full_ = false;
+		if (std::exchange(read_paused_, false))
+		{
+			DoContinueSession();
+		}
+	}
+	DoFlush();
+}
+
+size_t Connection::ReleaseQueuedBytes(const size_t bytes) noexcept
+{
+	server_state_.RemoveBufferedBytes(bytes);
+	return queued_bytes_.fetch_sub(bytes) - bytes;
+}
+
+void Connection::FinishRequest() noexcept
+{
+	// Only responses to admitted requests finish them, so counter never goes below zero.
+	if (requests_in_flight_ != 0)
+	{
+		--requests_in_flight_;
+		server_state_.RemoveRequest();
+		if (requests_in_flight_ == 0)
+		{
+			requests_work_.reset();
+		}
+	}
+}
+
+std::string_view Connection::GetMemoryData(const OutputData& data) noexcept
+{
+	if (const auto* string = std::get_if<std::string>(&data))
+	{
+		return *string;
+	}
+	const auto* buffer = std::get_if<SharedBuffer>(&data);
+	return buffer && *buffer ? std::string_view{**buffer} : std::string_view{};
+}
+
+HttpRequestConnectionUPtr Connection::MakeHttpRequest(HttpRequest http_request)
+{
+	// Storage is busy only if handler still holds previous request (e.g. after sending response from other thread).
+	bool in_use = false;
+	if (!request_in_use_.compare_exchange_strong(in_use, true, std::memory_order_acquire))
+	{
+		return HttpRequestConnectionUPtr{new HttpRequestConnection{std::move(http_request), shared_from_this()}};
+	}
+
+	request_.emplace(std::move(http_request), shared_from_this());
+	request_->embedded_ = true;
+	return HttpRequestConnectionUPtr{&*request_};
+}
+
+void Connection::ReleaseRequest() noexcept
+{
+	request_.reset();
+	request_in_use_.store(false, std::memory_order_release);
 }
 
 } // namespace Http::Server
@@ -0,0 +1,80 @@
+#include <CustomServer/CpuAffinity.hpp>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <string>
+
+
+namespace Http::Server
+{
+
+namespace
+{
+
+unsigned ParseCpu(const std::string_view value, const std::string_view list)
+{
+	unsigned cpu = 0;
+	const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), cpu);
+	// CPU beyond cpu_set_t can't be pinned, bound also keeps range loop finite.
+	if (ec != std::errc{} || end != value.data() + value.size() || cpu >= CPU_SETSIZE)
+	{
+		throw std::runtime_error("Incorrect CPU list " + std::string{list});
+	}
+	return cpu;
+}
+
+} // namespace
+
+std::vector<unsigned> ParseCpuList(const std::string_view list)
+{
+	std::vector<unsigned> cpus;
+	size_t position = 0;
+	while (position <= list.size())
+	{
+		const auto comma = std::min(list.find(',', position), list.size());
+		const auto range = list.substr(position, comma - position);
+		const auto dash = range.find('-');
+		const auto first = ParseCpu(range.substr(0, dash), list);
+		const auto last = dash == std::string_view::npos ? first : ParseCpu(range.substr(dash + 1), list);
+		if (last < first)
+		{
+			throw std::runtime_error("Incorrect CPU list " + std::string{list});
+		}
+		for (auto cpu = first; cpu <= last; ++cpu)
+		{
+			cpus.push_back(cpu);
+		}
+		position = comma + 1;
+	}
+	return cpus;
+}
+
+bool PinCurrentThread(const unsigned cpu) noexcept
+{
+	if (cpu >= CPU_SETSIZE)
+	{
+		return false;
+	}
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(cpu, &cpu_set);
+	return ::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+}
+
+std::optional<unsigned> GetIncomingCpu(const int fd) noexcept
+{
+	int cpu = -1;
+	socklen_t size = sizeof(cpu);
+	if (::getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &size) != 0 || cpu < 0)
+	{
+		return std::nullopt;
+	}
+	return static_cast<unsigned>(cpu);
+}
+
+} // namespace Http::Server
@@ -0,0 +1,164 @@
+#include <CustomServer/FileMetadataCache.hpp>
+
+#include <CustomServer/OpenBeneath.hpp>
+
+#include <Http/Types.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+
+namespace Http::Server
+{
+
+namespace
+{
+
+struct VariantSuffix final
+{
+	ContentEncoding encoding;
+	const char* suffix;
+};
+
+// Ordered by server preference: better compression ratio first.
+constexpr std::array<VariantSuffix, 3> variant_suffixes = {{
+	{ContentEncoding::Brotli, ".br"},
+	{ContentEncoding::Zstd, ".zst"},
+	{ContentEncoding::Gzip, ".gz"},
+}};
+
+} // namespace
+
+std::string MakeETag(const struct stat& st)
+{
+	char buffer[96];
+	const auto size = std::snprintf(
+		buffer,
+		sizeof(buffer),
+		"\"%llx-%llx-%llx%09lx\"",
+		static_cast<unsigned long long>(st.st_ino),
+		static_cast<unsigned long long>(st.st_size),
+		static_cast<unsigned long long>(st.st_mtim.tv_sec),
+		static_cast<unsigned long>(st.st_mtim.tv_nsec));
+	return std::string{buffer, static_cast<size_t>(size)};
+}
+
+FileMetadataCache::FileMetadataCache(const int root_fd, const std::chrono::milliseconds ttl, const size_t max_entries)
+	: root_fd_(root_fd)
+	, ttl_(ttl)
+	, max_entries_(max_entries)
+{
+}
+
+FileMetadataPtr FileMetadataCache::Get(const std::string& path)
+{
+	if (auto metadata = Find(path))
+	{
+		return std::move(*metadata);
+	}
+
+	// Stat without lock, other threads can use cache meanwhile.
+	const auto now = std::chrono::steady_clock::now();
+	auto metadata = ReadMetadataWithVariants(path);
+
+	std::lock_guard lock{mutex_};
+	Shrink(now);
+	entries_[path] = Entry{metadata, now};
+	return metadata;
+}
+
+std::optional<FileMetadataPtr> FileMetadataCache::Find(const std::string& path)
+{
+	const auto now = std::chrono::steady_clock::now();
+	std::lock_guard lock{mutex_};
+	const auto it = entries_.find(path);
+	if (it == entries_.cend() || now - it->second.checked_at >= ttl_)
+	{
+		return std::nullopt;
+	}
+	return it->second.metadata;
+}
+
+std::shared_ptr<FileMetadata> FileMetadataCache::ReadMetadata(const std::string& path) const
+{
+	// Path is resolved by the same rules as served files, so symlinks can't expose files outside root.
+	const auto fd = OpenBeneath(root_fd_, path, O_PATH);
+	if (fd < 0)
+	{
+		return nullptr;
+	}
+	struct stat st{};
+	const auto stat_result = ::fstat(fd, &st);
+	::close(fd);
+	if (stat_result != 0)
+	{
+		return nullptr;
+	}
+
+	auto metadata = std::make_shared<FileMetadata>();
+	metadata->is_directory = S_ISDIR(st.st_mode);
+	metadata->is_regular_file = S_ISREG(st.st_mode);
+	metadata->size = static_cast<size_t>(st.st_size);
+	metadata->modification_time = st.st_mtim.tv_sec;
+
+	if (metadata->is_regular_file)
+	{
+		metadata->etag = MakeETag(st);
+		metadata->last_modified = FormatHttpDate(metadata->modification_time);
+
+		HttpResponse not_modified{StatusCode::NotModified};
+		not_modified.SetHeader("ETag", metadata->etag);
+		not_modified.SetHeader("Last-Modified", metadata->last_modified);
+		metadata->not_modified_response = std::move(not_modified);
+	}
+	return metadata;
+}
+
+FileMetadataPtr FileMetadataCache::ReadMetadataWithVariants(const std::string& path) const
+{
+	auto metadata = ReadMetadata(path);
+	if (!metadata || !metadata->is_regular_file)
+	{
+		return metadata;
+	}
+
+	for (const auto& [encoding, suffix] : variant_suffixes)
+	{
+		auto variant_path = path + suffix;
+		auto variant_metadata = ReadMetadata(variant_path);
+		// Ignore stale variants, they could be left after file update.
+		if (!variant_metadata
+			|| !variant_metadata->is_regular_file
+			|| variant_metadata->modification_time < metadata->modification_time)
+		{
+			continue;
+		}
+		metadata->variants.push_back(FileVariant{encoding, std::move(variant_path), std::move(variant_metadata)});
+	}
+	return metadata;
+}
+
+void FileMetadataCache::Shrink(const std::chrono::steady_clock::time_point now)
+{
+	if (entries_.size() < max_entries_)
+	{
+		return;
+	}
+
+	for (auto it = entries_.begin(); it != entries_.end();)
+	{
+		it = now - it->second.checked_at >= ttl_ ? entries_.erase(it) : std::next(it);
+	}
+
+	if (entries_.size() >= max_entries_)
+	{
+		entries_.clear();
+	}
+}
+
+} // namespace Http::Server
@@ -4,12 +4,84 @@
 
 #include <Http/HttpResponse.hpp>
 
+#include <iostream>
 #include <stdexcept>
+#include <variant>
 
 
 namespace Http::Server
 {
 
+namespace
+{
+
+/**
+ * \brief Sends generated body, next part is generated when previous one is written.
+ */
+class GeneratedBodyWriter final : public std::enable_shared_from_this<GeneratedBodyWriter>
+{
+public:
+	GeneratedBodyWriter(ResponseStream stream, BodyGenerator generator)
+		: stream_(std::move(stream))
+		, generator_(std::move(generator))
+	{
+	}
+
+	/**
+	 * \brief Send next part of body or finish response.
+	 */
+	void WriteNext()
+	{
+		std::optional<std::string> part;
+		try
+		{
+			part = generator_.generate();
+		}
+		catch (const std::exception& exc)
+		{
+			// Stream is destroyed unfinished, so connection is closed.
+			std::cerr << "Can't generate response body: " << exc.what() << std::endl;
+			return;
+		}
+
+		if (!part)
+		{
+			stream_.Finish();
+			return;
+		}
+		stream_.Write(
+			std::move(*part),
+			[self = shared_from_this()](const boost::system::error_code& ec)
+			{
+				if (!ec)
+				{
+					self->WriteNext();
+				}
+			});
+	}
+
+private:
+	//! Response stream.
+	ResponseStream stream_;
+	//! Body generator.
+	BodyGenerator generator_;
+};
+
+} // namespace
+
+void HttpRequestConnectionDeleter::operator()(HttpRequestConnection* http_request) const noexcept
+{
+	if (!http_request->embedded_)
+	{
+		delete http_request;
+		return;
+	}
+
+	// Connection holds request storage, so it should live until request is destroyed.
+	const auto connection = http_request->connection_;
+	connection->ReleaseRequest();
+}
+
 HttpRequestConnection::HttpRequestConnection(HttpRequest http_request, ConnectionPtr connection)
 	: request_(std::move(http_request))
 	, connection_(std::move(connection))
@@ -26,8 +98,62 @@ bool HttpRequestConnection::Send(const HttpResponse& msg)
 	{
 		return false;
 	}
+	if (const auto* generator = std::get_if<BodyGenerator>(&msg.GetHttpBody()))
+	{
+		auto stream = StartStream(msg, generator->size);
+		if (!stream)
+		{
+			return false;
+		}
+		std::make_shared<GeneratedBodyWriter>(std::move(*stream), *generator)->WriteNext();
+		return true;
+	}
+
 	response_sended_ = true;
-	return connection_->Write(msg.PackToString(), request_.IsKeepAlive());
+	return connection_->Write(request_, msg);
+}
+
+std::optional<ResponseStream> HttpRequestConnection::StartStream(
+	HttpResponse response,
+	const std::optional<size_t> content_length)
+{
+	if (response_sended_)
+	{
+		return std::nullopt;
+	}
+	response_sended_ = true;
+
+	response.SetBody({});
+	const auto has_body = StatusCodeAllowsBody(response.GetStatusCode());
+	const auto& version = request_.GetHTTPVersion();
+	const auto can_chunk = version.major > 1 || (version.major == 1 && version.minor >= 1);
+	auto chunked = false;
+	if (has_body && content_length)
+	{
+		response.SetHeader("Content-Length", std::to_string(*content_length));
+	}
+	else if (has_body)
+	{
+		response.RemoveHeader("Content-Length");
+		chunked = can_chunk;
+		// Without length and chunks end of body is marked by connection close.
+		response.SetHeader(chunked ? "Transfer-Encoding" : "Connection", chunked ? "chunked" : "close");
+	}
+
+	auto keep_alive = false;
+	auto head = connection_->PackResponseHead(request_, response, keep_alive);
+	if (!connection_->Write(std::move(head), WriteCompletion::None))
+	{
+		return std::nullopt;
+	}
+
+	const auto headers_only = !has_body || request_.GetMethodType() == HttpMethodType::Head;
+	return ResponseStream{connection_, chunked, headers_only, keep_alive};
+}
+
+void HttpRequestConnection::Post(std::function<void()> task)
+{
+	connection_->Post(std::move(task));
 }
 
 const HttpRequest& HttpRequestConnection::GetRequest() const noexcept
@@ -35,11 +161,26 @@ const HttpRequest& HttpRequestConnection::GetRequest() const noexcept
 	return request_;
 }
 
+const std::optional<TraceContext>& HttpRequestConnection::GetTraceContext() const noexcept
+{
+	return trace_context_;
+}
+
 bool HttpRequestConnection::IsAlive() const noexcept
 {
 	return connection_->ConnectionIsAvailable();
 }
 
+size_t HttpRequestConnection::GetQueuedBytes() const noexcept
+{
+	return connection_->GetQueuedBytes();
+}
+
+bool HttpRequestConnection::IsWriteQueueFull() const noexcept
+{
+	return connection_->IsWriteQueueFull();
+}
+
 HttpRequestConnection::~HttpRequestConnection()
 {
 	if (!response_sended_)
@@ -0,0 +1,130 @@
+#include <CustomServer/ListenerHandoff.hpp>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+
+namespace Http::Server
+{
+
+namespace
+{
+
+//! First descriptor passed by socket activation.
+constexpr int listen_fds_start = 3;
+
+} // namespace
+
+int TakeInheritedListener() noexcept
+{
+	const auto* pid = std::getenv("LISTEN_PID");
+	const auto* fds = std::getenv("LISTEN_FDS");
+	if (!pid || !fds || std::strtol(pid, nullptr, 10) != ::getpid() || std::strtol(fds, nullptr, 10) < 1)
+	{
+		return -1;
+	}
+
+	// Child processes shouldn't take the same listener.
+	::unsetenv("LISTEN_PID");
+	::unsetenv("LISTEN_FDS");
+	::fcntl(listen_fds_start, F_SETFD, FD_CLOEXEC);
+	return listen_fds_start;
+}
+
+std::optional<HandedOffListener> RequestListener(const std::string& path)
+{
+	sockaddr_un address{};
+	if (path.size() >= sizeof(address.sun_path))
+	{
+		throw std::runtime_error("Handoff socket path is too long " + path);
+	}
+	address.sun_family = AF_UNIX;
+	std::memcpy(address.sun_path, path.data(), path.size());
+
+	const auto channel = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (channel < 0)
+	{
+		throw std::runtime_error(std::string{"Can't create handoff socket: "} + std::strerror(errno));
+	}
+	// Stale socket file is left by stopped server, so failed connect means fresh start.
+	if (::connect(channel, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		::close(channel);
+		return std::nullopt;
+	}
+
+	char byte = 0;
+	iovec data{&byte, sizeof(byte)};
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+	msghdr message{};
+	message.msg_iov = &data;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	ssize_t received = 0;
+	do
+	{
+		received = ::recvmsg(channel, &message, MSG_CMSG_CLOEXEC);
+	}
+	while (received < 0 && errno == EINTR);
+
+	const auto* header = received > 0 ? CMSG_FIRSTHDR(&message) : nullptr;
+	if (!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+	{
+		::close(channel);
+		throw std::runtime_error("Running server didn't pass listener");
+	}
+
+	HandedOffListener handed_off;
+	std::memcpy(&handed_off.listener, CMSG_DATA(header), sizeof(int));
+	handed_off.channel = channel;
+	return handed_off;
+}
+
+void ConfirmListener(const int channel) noexcept
+{
+	ssize_t sent = 0;
+	do
+	{
+		sent = ::send(channel, &listener_confirmation, sizeof(listener_confirmation), MSG_NOSIGNAL);
+	}
+	while (sent < 0 && errno == EINTR);
+	::close(channel);
+}
+
+bool SendListener(const int channel, const int listener) noexcept
+{
+	char byte = 0;
+	iovec data{&byte, sizeof(byte)};
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+	msghdr message{};
+	message.msg_iov = &data;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	auto* header = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type = SCM_RIGHTS;
+	header->cmsg_len = CMSG_LEN(sizeof(int));
+	std::memcpy(CMSG_DATA(header), &listener, sizeof(int));
+
+	ssize_t sent = 0;
+	do
+	{
+		sent = ::sendmsg(channel, &message, MSG_NOSIGNAL);
+	}
+	while (sent < 0 && errno == EINTR);
+	return sent == 1;
+}
+
+} // namespace Http::Server
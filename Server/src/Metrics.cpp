@@ -0,0 +1,261 @@
+#include <CustomServer/Metrics.hpp>
+
+#include <CustomServer/BlockingTaskPool.hpp>
+#include <CustomServer/ServerState.hpp>
+#include <CustomServer/SocketOptions.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <utility>
+
+
+namespace Http::Server
+{
+
+namespace
+{
+
+//! Exported quantiles of histograms.
+constexpr double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+/**
+ * \brief Exported histogram.
+ */
+struct HistogramDescription final
+{
+	Metric metric;
+	const char* name;
+	const char* help;
+	//! Recorded value is multiplied by it (microseconds are exported as seconds).
+	double scale;
+};
+
+constexpr HistogramDescription histograms[] = {
+	{Metric::RequestLatency, "http_server_request_duration_seconds", "Time from first bytes of request to written response.", 1e-6},
+	{Metric::ParseTime, "http_server_request_parse_seconds", "Time from first bytes of request to parsed request.", 1e-6},
+	{Metric::HandlerTime, "http_server_handler_seconds", "Time from passing request to handler to first response bytes.", 1e-6},
+	{Metric::WriteTime, "http_server_response_write_seconds", "Time from first response bytes to written response.", 1e-6},
+	{Metric::RequestSize, "http_server_request_size_bytes", "Bytes read while request was parsed.", 1},
+	{Metric::ResponseSize, "http_server_response_size_bytes", "Response bytes with headers.", 1},
+};
+
+void WriteHeader(std::ostream& stream, const char* name, const char* type, const char* help)
+{
+	stream << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+}
+
+void WriteValue(std::ostream& stream, const char* name, const char* type, const char* help, const uint64_t value)
+{
+	WriteHeader(stream, name, type, help);
+	stream << name << ' ' << value << '\n';
+}
+
+} // namespace
+
+size_t HistogramBuckets::GetBucket(const uint64_t value) noexcept
+{
+	if (value < sub_buckets)
+	{
+		return static_cast<size_t>(value);
+	}
+	if (value >> max_exponent != 0)
+	{
+		return count - 1;
+	}
+	// Power of two is split into sub_buckets by bits following highest one.
+	const auto exponent = static_cast<size_t>(63 - __builtin_clzll(value));
+	const auto sub_bucket = static_cast<size_t>(value >> (exponent - 4)) - sub_buckets;
+	return (exponent - 3) * sub_buckets + sub_bucket;
+}
+
+uint64_t HistogramBuckets::GetMaxValue(const size_t bucket) noexcept
+{
+	if (bucket < sub_buckets)
+	{
+		return bucket;
+	}
+	const auto exponent = bucket / sub_buckets + 3;
+	const auto sub_bucket = uint64_t{bucket % sub_buckets + sub_buckets};
+	return ((sub_bucket + 1) << (exponent - 4)) - 1;
+}
+
+static_assert(HistogramBuckets::sub_buckets == 16, "Bucket of value uses 4 bits after highest one");
+
+HistogramSnapshot::HistogramSnapshot()
+	: buckets_(HistogramBuckets::count)
+{
+}
+
+uint64_t HistogramSnapshot::GetCount() const noexcept
+{
+	return count_;
+}
+
+uint64_t HistogramSnapshot::GetSum() const noexcept
+{
+	return sum_;
+}
+
+uint64_t HistogramSnapshot::GetQuantile(const double quantile) const noexcept
+{
+	if (count_ == 0)
+	{
+		return 0;
+	}
+	const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(count_))));
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < buckets_.size(); ++bucket)
+	{
+		seen += buckets_[bucket];
+		if (seen >= rank)
+		{
+			return HistogramBuckets::GetMaxValue(bucket);
+		}
+	}
+	return HistogramBuckets::GetMaxValue(buckets_.size() - 1);
+}
+
+Metrics::Metrics(const size_t shards_count)
+	: shards_(std::max<size_t>(shards_count, 1))
+{
+}
+
+void Metrics::Record(const Metric metric, const uint64_t value) noexcept
+{
+	auto& histogram = GetShard().histograms[static_cast<size_t>(metric)];
+	histogram.buckets[HistogramBuckets::GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+	histogram.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+void Metrics::AddResponse(const unsigned status_code) noexcept
+{
+	if (status_code < max_status_code)
+	{
+		GetShard().responses[status_code].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+HistogramSnapshot Metrics::GetHistogram(const Metric metric) const
+{
+	// Buckets are read one by one, so snapshot may miss values recorded while merging.
+	HistogramSnapshot snapshot;
+	for (const auto& shard : shards_)
+	{
+		const auto& histogram = shard.histograms[static_cast<size_t>(metric)];
+		for (size_t bucket = 0; bucket < HistogramBuckets::count; ++bucket)
+		{
+			const auto count = histogram.buckets[bucket].load(std::memory_order_relaxed);
+			snapshot.buckets_[bucket] += count;
+			snapshot.count_ += count;
+		}
+		snapshot.sum_ += histogram.sum.load(std::memory_order_relaxed);
+	}
+	return snapshot;
+}
+
+std::vector<std::pair<unsigned, uint64_t>> Metrics::GetResponses() const
+{
+	std::vector<std::pair<unsigned, uint64_t>> responses;
+	for (unsigned status_code = 0; status_code < max_status_code; ++status_code)
+	{
+		uint64_t count = 0;
+		for (const auto& shard : shards_)
+		{
+			count += shard.responses[status_code].load(std::memory_order_relaxed);
+		}
+		if (count != 0)
+		{
+			responses.emplace_back(status_code, count);
+		}
+	}
+	return responses;
+}
+
+void Metrics::AddCollector(std::function<std::string()> collector)
+{
+	collectors_.push_back(std::move(collector));
+}
+
+const std::vector<std::function<std::string()>>& Metrics::GetCollectors() const noexcept
+{
+	return collectors_;
+}
+
+Metrics::Shard& Metrics::GetShard() noexcept
+{
+	return shards_[State::GetCurrentThreadShard() % shards_.size()];
+}
+
+std::string FormatPrometheusMetrics(const State& state)
+{
+	const auto counters = state.GetCounters();
+	const auto accept_stats = state.GetAcceptStats();
+	const auto& metrics = state.GetMetrics();
+
+	std::ostringstream stream;
+	stream.precision(9);
+	WriteValue(stream, "http_server_connections", "gauge", "Open connections.", counters.connections);
+	WriteValue(stream, "http_server_requests_in_flight", "gauge", "Requests being handled.", counters.requests_in_flight);
+	WriteValue(stream, "http_server_buffered_bytes", "gauge", "Bytes queued for writing.", counters.buffered_bytes);
+	WriteValue(stream, "http_server_requests_total", "counter", "Finished requests.", counters.requests);
+	WriteValue(stream, "http_server_rejected_requests_total", "counter", "Requests answered with 503 by admission control.", counters.rejected_requests);
+	WriteValue(stream, "http_server_received_bytes_total", "counter", "Bytes read from sockets.", counters.bytes_received);
+	WriteValue(stream, "http_server_sent_bytes_total", "counter", "Bytes written into sockets.", counters.bytes_sent);
+	WriteValue(stream, "http_server_accepted_connections_total", "counter", "Accepted connections.", accept_stats.accepted);
+	WriteValue(stream, "http_server_accept_errors_total", "counter", "Failed accepts.", accept_stats.errors);
+	WriteValue(stream, "http_server_listen_overflows_total", "counter", "Connections dropped by full accept queues of system.", GetListenOverflows());
+
+	WriteHeader(stream, "http_server_errors_total", "counter", "Connection errors.");
+	stream << "http_server_errors_total{type=\"read\"} " << counters.read_errors << '\n'
+		<< "http_server_errors_total{type=\"write\"} " << counters.write_errors << '\n'
+		<< "http_server_errors_total{type=\"bad_request\"} " << counters.bad_requests << '\n'
+		<< "http_server_errors_total{type=\"timeout\"} " << counters.timeouts << '\n';
+
+	WriteHeader(stream, "http_server_responses_total", "counter", "Responses by status code.");
+	for (const auto& [status_code, count] : metrics.GetResponses())
+	{
+		stream << "http_server_responses_total{code=\"" << status_code << "\"} " << count << '\n';
+	}
+
+	for (const auto& description : histograms)
+	{
+		const auto histogram = metrics.GetHistogram(description.metric);
+		WriteHeader(stream, description.name, "summary", description.help);
+		for (const auto quantile : quantiles)
+		{
+			stream << description.name << "{quantile=\"" << quantile << "\"} "
+				<< static_cast<double>(histogram.GetQuantile(quantile)) * description.scale << '\n';
+		}
+		stream << description.name << "_sum " << static_cast<double>(histogram.GetSum()) * description.scale << '\n'
+			<< description.name << "_count " << histogram.GetCount() << '\n';
+	}
+
+	for (const auto& collector : metrics.GetCollectors())
+	{
+		stream << collector();
+	}
+	return stream.str();
+}
+
+std::string FormatPrometheusMetrics(const BlockingTaskPoolStatistics& statistics)
+{
+	std::ostringstream stream;
+	stream.precision(9);
+	WriteValue(stream, "http_server_blocking_queue_size", "gauge", "Blocking tasks waiting in queue.", statistics.queue_size);
+	WriteValue(stream, "http_server_blocking_queue_capacity", "gauge", "Max blocking tasks waiting in queue.", statistics.max_queue_size);
+
+	WriteHeader(stream, "http_server_blocking_tasks_total", "counter", "Blocking tasks by result.");
+	stream << "http_server_blocking_tasks_total{result=\"completed\"} " << statistics.completed_tasks << '\n'
+		<< "http_server_blocking_tasks_total{result=\"rejected\"} " << statistics.rejected_tasks << '\n'
+		<< "http_server_blocking_tasks_total{result=\"discarded\"} " << statistics.discarded_tasks << '\n';
+
+	WriteHeader(stream, "http_server_blocking_queue_wait_seconds", "summary", "Time blocking tasks spent in queue.");
+	stream << "http_server_blocking_queue_wait_seconds_sum " << static_cast<double>(statistics.total_wait_time.count()) * 1e-6 << '\n'
+		<< "http_server_blocking_queue_wait_seconds_count " << statistics.completed_tasks << '\n';
+	WriteHeader(stream, "http_server_blocking_queue_wait_max_seconds", "gauge", "Max time blocking task spent in queue.");
+	stream << "http_server_blocking_queue_wait_max_seconds " << static_cast<double>(statistics.max_wait_time.count()) * 1e-6 << '\n';
+	return stream.str();
+}
+
+} // namespace Http::Server
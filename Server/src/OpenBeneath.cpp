@@ -0,0 +1,101 @@
+#include <CustomServer/OpenBeneath.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/openat2.h>)
+#include <linux/openat2.h>
+#include <sys/syscall.h>
+#if defined(SYS_openat2)
+#define HTTP_SERVER_HAS_OPENAT2
+#endif // defined(SYS_openat2)
+#endif // defined(__linux__) && __has_include(<linux/openat2.h>)
+
+#include <atomic>
+#include <cerrno>
+#include <string_view>
+
+
+namespace Http::Server
+{
+
+namespace
+{
+
+/**
+ * \brief Close descriptor, keep errno of failed call.
+ */
+void CloseKeepErrno(const int fd) noexcept
+{
+	const auto error = errno;
+	::close(fd);
+	errno = error;
+}
+
+/**
+ * \brief Open path component by component, symlinks aren't followed, so path can't leave root.
+ */
+int OpenByComponents(const int root_fd, const std::string& path, const int flags)
+{
+	if (path == ".")
+	{
+		return ::openat(root_fd, ".", flags | O_CLOEXEC);
+	}
+
+	auto directory_fd = root_fd;
+	std::string_view rest{path};
+	while (true)
+	{
+		const auto separator = rest.find('/');
+		const std::string component{rest.substr(0, separator)};
+		if (component.empty() || component == "." || component == "..")
+		{
+			if (directory_fd != root_fd)
+			{
+				::close(directory_fd);
+			}
+			errno = EXDEV;
+			return -1;
+		}
+
+		const auto is_last = separator == std::string_view::npos;
+		const auto fd = is_last
+			? ::openat(directory_fd, component.c_str(), flags | O_NOFOLLOW | O_CLOEXEC)
+			: ::openat(directory_fd, component.c_str(), O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+		if (directory_fd != root_fd)
+		{
+			CloseKeepErrno(directory_fd);
+		}
+		if (fd < 0 || is_last)
+		{
+			return fd;
+		}
+		directory_fd = fd;
+		rest.remove_prefix(separator + 1);
+	}
+}
+
+} // namespace
+
+int OpenBeneath(const int root_fd, const std::string& path, const int flags)
+{
+#if defined(HTTP_SERVER_HAS_OPENAT2)
+	// Kernel refuses any resolution (symlinks too) which escapes root.
+	static std::atomic_bool openat2_is_supported = true;
+	if (openat2_is_supported)
+	{
+		open_how how{};
+		how.flags = static_cast<uint64_t>(flags | O_CLOEXEC);
+		how.resolve = RESOLVE_BENEATH;
+		const auto fd = static_cast<int>(::syscall(SYS_openat2, root_fd, path.c_str(), &how, sizeof(how)));
+		if (fd >= 0 || (errno != ENOSYS && errno != EPERM))
+		{
+			return fd;
+		}
+		openat2_is_supported = false;
+	}
+#endif // defined(HTTP_SERVER_HAS_OPENAT2)
+	return OpenByComponents(root_fd, path, flags);
+}
+
+} // namespace Http::Server
@@ -0,0 +1,56 @@
+#include <CustomServer/Pipeline.hpp>
+
+#include <stdexcept>
+#include <utility>
+
+
+namespace Http::Server
+{
+
+DynamicNext::DynamicNext(const DynamicPipeline& pipeline, const size_t index) noexcept
+	: pipeline_(pipeline)
+	, index_(index)
+{
+}
+
+void DynamicNext::operator()(HttpRequestConnectionUPtr http_request) const
+{
+	pipeline_.Call(index_, std::move(http_request));
+}
+
+DynamicPipeline::DynamicPipeline(DynamicHandler handler)
+	: handler_(std::move(handler))
+{
+	if (!handler_)
+	{
+		throw std::runtime_error("Pipeline handler isn't set");
+	}
+}
+
+DynamicPipeline& DynamicPipeline::Use(DynamicMiddleware middleware)
+{
+	if (!middleware)
+	{
+		throw std::runtime_error("Middleware isn't set");
+	}
+
+	middlewares_.push_back(std::move(middleware));
+	return *this;
+}
+
+void DynamicPipeline::operator()(HttpRequestConnectionUPtr http_request) const
+{
+	Call(0, std::move(http_request));
+}
+
+void DynamicPipeline::Call(const size_t index, HttpRequestConnectionUPtr http_request) const
+{
+	if (index < middlewares_.size())
+	{
+		middlewares_[index](std::move(http_request), DynamicNext{*this, index + 1});
+		return;
+	}
+	handler_(std::move(http_request));
+}
+
+} // namespace Http::Server
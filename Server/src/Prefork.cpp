@@ -0,0 +1,283 @@
+#include <CustomServer/Prefork.hpp>
+
+#include <CustomServer/ServerState.hpp>
+
+#include <boost/asio.hpp>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+
+
+namespace Http::Server
+{
+
+namespace
+{
+
+//! Master wakes up with this interval to restart workers.
+constexpr auto master_tick = std::chrono::milliseconds{100};
+
+void PrintCounters(const ClusterCounters& counters)
+{
+	std::cout << "Workers " << counters.workers << ", restarts " << counters.restarts
+		<< ", connections " << counters.connections << ", requests in flight " << counters.requests_in_flight
+		<< ", accepted " << counters.accepted_connections << ", rejected " << counters.rejected_requests << std::endl;
+}
+
+} // namespace
+
+CountersPublisher::CountersPublisher(
+	const State& state,
+	WorkerCounters& counters,
+	const std::chrono::milliseconds interval)
+	: state_(state)
+	, counters_(counters)
+	, interval_(interval)
+{
+	thread_ = std::thread{
+		[this]()
+		{
+			std::unique_lock lock{mutex_};
+			while (!condition_.wait_for(lock, interval_, [this]() { return stopped_; }))
+			{
+				Publish();
+			}
+		}};
+}
+
+CountersPublisher::~CountersPublisher()
+{
+	{
+		std::lock_guard lock{mutex_};
+		stopped_ = true;
+	}
+	condition_.notify_all();
+	thread_.join();
+	Publish();
+}
+
+void CountersPublisher::Publish() noexcept
+{
+	const auto counters = state_.GetCounters();
+	counters_.connections = counters.connections;
+	counters_.requests_in_flight = counters.requests_in_flight;
+	counters_.rejected_requests = counters.rejected_requests;
+	counters_.accepted_connections = state_.GetAcceptStats().accepted;
+}
+
+PreforkMaster::PreforkMaster(
+	const PreforkOptions& options,
+	const std::string& address,
+	const std::string& port,
+	const ListenerOptions& listener_options)
+	: options_(options)
+	, restart_times_(options_.workers)
+{
+	if (options_.workers == 0)
+	{
+		throw std::runtime_error("Workers count should be more than 0");
+	}
+
+	// Listeners belong to master, so connections wait in accept queue while worker is restarted.
+	boost::asio::io_context io_context;
+	boost::asio::ip::tcp::resolver resolver(io_context);
+	const boost::asio::ip::tcp::endpoint endpoint = *resolver.resolve(address, port).begin();
+	auto worker_listener_options = listener_options;
+	worker_listener_options.reuse_port = options_.reuse_port;
+	const auto listeners_count = options_.reuse_port ? options_.workers : 1;
+	for (size_t i = 0; i < listeners_count; ++i)
+	{
+		listeners_.push_back(CreateListener(endpoint, worker_listener_options));
+	}
+
+	const auto size = sizeof(WorkerCounters) * options_.workers;
+	auto* memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+	{
+		throw std::runtime_error(std::string{"Can't map shared counters: "} + std::strerror(errno));
+	}
+	counters_ = static_cast<WorkerCounters*>(memory);
+	for (size_t i = 0; i < options_.workers; ++i)
+	{
+		new (counters_ + i) WorkerCounters{};
+	}
+}
+
+int PreforkMaster::Run(const WorkerMain& worker_main)
+{
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	sigaddset(&signals, SIGQUIT);
+	sigaddset(&signals, SIGCHLD);
+	sigset_t previous_signals;
+	// Signals are handled synchronously, workers restore mask and handle them by server.
+	::sigprocmask(SIG_BLOCK, &signals, &previous_signals);
+
+	for (size_t i = 0; i < options_.workers; ++i)
+	{
+		StartWorker(i, worker_main);
+	}
+
+	auto stopping = false;
+	while (true)
+	{
+		timespec timeout{0, std::chrono::duration_cast<std::chrono::nanoseconds>(master_tick).count()};
+		const auto signo = ::sigtimedwait(&signals, nullptr, &timeout);
+		if ((signo == SIGINT || signo == SIGTERM || signo == SIGQUIT) && !stopping)
+		{
+			std::cout << "Master got signal " << signo << ", stop workers" << std::endl;
+			stopping = true;
+			for (size_t i = 0; i < options_.workers; ++i)
+			{
+				if (const auto pid = counters_[i].pid.load(); pid != 0)
+				{
+					::kill(pid, SIGTERM);
+				}
+			}
+		}
+
+		int status = 0;
+		pid_t pid = 0;
+		while ((pid = ::waitpid(-1, &status, WNOHANG)) > 0)
+		{
+			for (size_t i = 0; i < options_.workers; ++i)
+			{
+				if (counters_[i].pid != pid)
+				{
+					continue;
+				}
+				RetireWorker(counters_[i]);
+				if (!stopping)
+				{
+					std::cerr << "Worker " << pid << " died with status " << status << ", restart it" << std::endl;
+					restart_times_[i] = std::chrono::steady_clock::now() + options_.restart_delay;
+				}
+			}
+		}
+
+		const auto counters = GetCounters();
+		if (stopping)
+		{
+			if (counters.workers == 0)
+			{
+				PrintCounters(counters);
+				break;
+			}
+			continue;
+		}
+
+		const auto now = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < options_.workers; ++i)
+		{
+			if (counters_[i].pid == 0 && now >= restart_times_[i])
+			{
+				++counters_[i].restarts;
+				StartWorker(i, worker_main);
+			}
+		}
+	}
+
+	::sigprocmask(SIG_SETMASK, &previous_signals, nullptr);
+	return 0;
+}
+
+ClusterCounters PreforkMaster::GetCounters() const noexcept
+{
+	auto cluster = retired_;
+	for (size_t i = 0; i < options_.workers; ++i)
+	{
+		const auto& counters = counters_[i];
+		if (counters.pid != 0)
+		{
+			++cluster.workers;
+		}
+		cluster.restarts += counters.restarts;
+		cluster.connections += counters.connections;
+		cluster.requests_in_flight += counters.requests_in_flight;
+		cluster.rejected_requests += counters.rejected_requests;
+		cluster.accepted_connections += counters.accepted_connections;
+	}
+	return cluster;
+}
+
+void PreforkMaster::RetireWorker(WorkerCounters& counters) noexcept
+{
+	// Slot is reused by restarted worker, so totals of dead process are kept by master.
+	retired_.rejected_requests += counters.rejected_requests.exchange(0);
+	retired_.accepted_connections += counters.accepted_connections.exchange(0);
+	counters.connections = 0;
+	counters.requests_in_flight = 0;
+	counters.pid = 0;
+}
+
+PreforkMaster::~PreforkMaster()
+{
+	for (const auto listener : listeners_)
+	{
+		::close(listener);
+	}
+	if (counters_)
+	{
+		::munmap(counters_, sizeof(WorkerCounters) * options_.workers);
+	}
+}
+
+void PreforkMaster::StartWorker(const size_t index, const WorkerMain& worker_main)
+{
+	// Buffered output would be written by both processes.
+	std::cout.flush();
+	std::cerr.flush();
+	const auto pid = ::fork();
+	if (pid < 0)
+	{
+		std::cerr << "Can't fork worker: " << std::strerror(errno) << std::endl;
+		restart_times_[index] = std::chrono::steady_clock::now() + options_.restart_delay;
+		return;
+	}
+	if (pid != 0)
+	{
+		counters_[index].pid = pid;
+		return;
+	}
+
+	sigset_t signals;
+	sigemptyset(&signals);
+	::sigprocmask(SIG_SETMASK, &signals, nullptr);
+
+	// Worker keeps only own listener.
+	const auto listener = listeners_[options_.reuse_port ? index : 0];
+	for (const auto other_listener : listeners_)
+	{
+		if (other_listener != listener)
+		{
+			::close(other_listener);
+		}
+	}
+
+	auto exit_code = EXIT_FAILURE;
+	try
+	{
+		exit_code = worker_main(listener, counters_[index]);
+	}
+	catch (const std::exception& exc)
+	{
+		std::cerr << "Worker failed: " << exc.what() << std::endl;
+	}
+	std::cout.flush();
+	std::cerr.flush();
+	// Master objects copied by fork aren't destroyed by worker.
+	::_exit(exit_code);
+}
+
+} // namespace Http::Server
@@ -1,12 +1,22 @@
 #include <CustomServer/RequestHandler.hpp>
 
+#include <CustomServer/OpenBeneath.hpp>
+
 #include <Http/HttpResponse.hpp>
 #include <Http/HttpRequest.hpp>
+#include <Http/Uri.hpp>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <cerrno>
 #include <filesystem>
-#include <fstream>
-#include <sstream>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <iostream>
 
 
@@ -31,53 +41,166 @@ std::string GetTypeByExt(const std::string_view extension)
 	return it != types.cend() ? std::string{it->second} : std::string{"text/plain"};
 }
 
-std::optional<std::string> UriDecode(const std::string& uri)
+const FileVariant* SelectVariant(const HttpRequest& http_req, const FileMetadata& metadata)
+{
+	const auto& headers = http_req.GetHeaders();
+	const auto it = headers.find("Accept-Encoding");
+	if (it == headers.cend())
+	{
+		return nullptr;
+	}
+
+	const AcceptEncoding accept_encoding{it->second};
+	const FileVariant* best_variant = nullptr;
+	auto best_quality = accept_encoding.GetQuality(ContentEncoding::Identity);
+	for (const auto& variant : metadata.variants)
+	{
+		const auto quality = accept_encoding.GetQuality(variant.encoding);
+		if (quality != 0 && (quality > best_quality || (!best_variant && quality == best_quality)))
+		{
+			best_variant = &variant;
+			best_quality = quality;
+		}
+	}
+	return best_variant;
+}
+
+// Resolve ".", ".." and duplicate slashes lexically, return nullopt if path escapes root.
+std::optional<std::string> NormalizePath(std::string_view path)
 {
 	std::string result;
-	result.reserve(uri.size());
-	for (std::size_t i = 0; i < uri.size(); ++i)
+	result.reserve(path.size());
+	while (!path.empty())
 	{
-		if (uri[i] == '+')
+		const auto separator = path.find('/');
+		const auto segment = path.substr(0, separator);
+		path.remove_prefix(separator == std::string_view::npos ? path.size() : separator + 1);
+
+		if (segment.empty() || segment == ".")
 		{
-			result += ' ';
 			continue;
 		}
-		if (uri[i] != '%')
+		if (segment == "..")
 		{
-			result += uri[i];
+			if (result.empty())
+			{
+				return std::nullopt;
+			}
+			const auto last_separator = result.rfind('/');
+			result.resize(last_separator == std::string::npos ? 0 : last_separator);
 			continue;
 		}
-		if (i + 3 > uri.size())
+		if (segment.find('\0') != std::string_view::npos)
 		{
 			return std::nullopt;
 		}
-
-		int value = 0;
-		std::istringstream is(uri.substr(i + 1, 2));
-		if (is >> std::hex >> value)
+		if (!result.empty())
 		{
-			result += static_cast<char>(value);
-			i += 2;
-		}
-		else
-		{
-			return std::nullopt;
+			result += '/';
 		}
+		result += segment;
 	}
 	return result;
 }
 
+struct DirectoryCloser final
+{
+	void operator()(DIR* directory) const noexcept
+	{
+		::closedir(directory);
+	}
+};
+
+// Extension of file name ("a/b.html" -> ".html", ".bashrc" -> "").
+std::string_view GetExtension(const std::string_view path)
+{
+	const auto separator = path.rfind('/');
+	const auto filename = separator == std::string_view::npos ? path : path.substr(separator + 1);
+	const auto dot = filename.rfind('.');
+	return dot == std::string_view::npos || dot == 0 ? std::string_view{} : filename.substr(dot);
+}
+
 } // namespace
 
+PreparedResponse::PreparedResponse(HttpResponse http_response)
+	: response(std::move(http_response))
+{
+}
+
+std::optional<std::string> RequestHandler::ReadFile(const int fd, const size_t size)
+{
+	std::string content;
+	content.resize(size);
+	size_t offset = 0;
+	while (offset < size)
+	{
+		const auto result = ::pread(fd, content.data() + offset, size - offset, static_cast<off_t>(offset));
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result <= 0)
+		{
+			break;
+		}
+		offset += static_cast<size_t>(result);
+	}
+	::close(fd);
+
+	if (offset != size)
+	{
+		return std::nullopt;
+	}
+	return content;
+}
+
 RequestHandler::RequestHandler(const std::string& doc_root)
-	: doc_root_(doc_root)
+	: doc_root_(std::filesystem::canonical(doc_root).string())
+	, root_fd_(::open(doc_root_.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC))
+	, metadata_cache_(root_fd_)
+{
+	if (root_fd_ < 0)
+	{
+		throw std::runtime_error("Can't open doc root " + doc_root_);
+	}
+}
+
+RequestHandler::~RequestHandler()
 {
+	::close(root_fd_);
 }
 
 HttpResponse RequestHandler::HandleRequest(const HttpRequest& http_req)
 {
-	// Decode url to path.
-	auto request_path = UriDecode(http_req.GetURI());
+	auto prepared = PrepareResponse(http_req);
+	if (!prepared.file_path)
+	{
+		return std::move(prepared.response);
+	}
+
+	const auto fd = OpenResponseFile(prepared);
+	if (fd < 0)
+	{
+		return StockResponse(StatusCode::NotFound);
+	}
+	prepared.response.SetFileBody(FileRegion{std::make_shared<FileDescriptor>(fd), 0, prepared.file_size});
+	return std::move(prepared.response);
+}
+
+PreparedResponse RequestHandler::PrepareResponse(const HttpRequest& http_req)
+{
+	return *DoPrepareResponse(http_req, true);
+}
+
+std::optional<PreparedResponse> RequestHandler::TryPrepareResponse(const HttpRequest& http_req)
+{
+	return DoPrepareResponse(http_req, false);
+}
+
+std::optional<PreparedResponse> RequestHandler::DoPrepareResponse(const HttpRequest& http_req, const bool may_block)
+{
+	// Decode url path, query and fragment are ignored.
+	auto request_path = PercentDecode(http_req.GetUriView().GetPath());
 	if (!request_path)
 	{
 		return StockResponse(StatusCode::BadRequest);
@@ -91,80 +214,87 @@ HttpResponse RequestHandler::HandleRequest(const HttpRequest& http_req)
 
 	try
 	{
-		const auto absolute_root_path = std::filesystem::absolute(std::filesystem::path(doc_root_));
-		const auto absolute_path = absolute_root_path / std::filesystem::path(*request_path);
-
-		const auto root_path_str = absolute_root_path.string();
-		const auto path_str = absolute_path.string();
-
-		if (root_path_str.size() > path_str.size())
+		// Path relative to doc root, "." is doc root itself.
+		auto relative_path = NormalizePath(*request_path);
+		if (!relative_path)
 		{
+			std::cout << "Not sub path" << std::endl;
 			return StockResponse(StatusCode::NotFound);
 		}
+		const auto is_root = relative_path->empty();
+		if (is_root)
+		{
+			*relative_path = ".";
+		}
 
-		if (!root_path_str.empty())
+		auto cached_metadata = may_block ? metadata_cache_.Get(*relative_path) : metadata_cache_.Find(*relative_path);
+		if (!cached_metadata)
 		{
-			const auto [it1, it2] = std::mismatch(path_str.cbegin(), path_str.cend(), root_path_str.cbegin(), root_path_str.cend());
+			return std::nullopt;
+		}
+		const auto metadata = std::move(*cached_metadata);
+		if (!metadata)
+		{
+			return StockResponse(StatusCode::NotFound);
+		}
 
-			if (it2 != root_path_str.cend())
+		// Served entity: file itself or its precompressed variant.
+		const auto* variant = metadata->is_regular_file ? SelectVariant(http_req, *metadata) : nullptr;
+		const auto& entity = variant ? *variant->metadata : *metadata;
+		const auto has_variants = !metadata->variants.empty();
+
+		if (metadata->is_regular_file && IsNotModified(http_req, entity))
+		{
+			auto rep = *entity.not_modified_response;
+			if (has_variants)
 			{
-				std::cout << "Not sub path" << std::endl;
-				return StockResponse(StatusCode::NotFound);
+				rep.SetHeader("Vary", "Accept-Encoding");
 			}
+			return rep;
 		}
-		HttpResponse rep{StatusCode::Ok};
-		std::string extension;
-		if (std::filesystem::is_directory(absolute_path))
+
+		PreparedResponse prepared{HttpResponse{StatusCode::Ok}};
+		auto& rep = prepared.response;
+		std::string_view extension;
+		if (metadata->is_directory && !may_block)
+		{
+			return std::nullopt;
+		}
+		if (metadata->is_directory)
 		{
 			extension = ".html";
-			std::string htmp_to_return = "<html>";
-			htmp_to_return += "<head><title> Index of " + *request_path + "</title></head>\n<body>\n";
-			htmp_to_return += "<h1>Index of " + *request_path + "</h1><hr><pre>\n";
-			if (path_str.size() != root_path_str.size())
-			{
-				htmp_to_return += "<a href=\"../\">../</a>\n";
-			}
-
-			for (const auto& entry : std::filesystem::directory_iterator(absolute_path))
+			auto listing = ListDirectory(*relative_path, *request_path, is_root);
+			if (!listing)
 			{
-				const auto& path = entry.path();;
-				const auto filename = path.filename().string();
-				htmp_to_return += "<a href=\"" + filename + "\">" + filename + "</a>\n";
+				return StockResponse(StatusCode::NotFound);
 			}
-			htmp_to_return += "</pre><hr></body>\n</html>";
-			rep.SetBody(std::move(htmp_to_return));
+			rep.SetBody(std::move(*listing));
 		}
-		else if (std::filesystem::is_regular_file(absolute_path))
+		else if (metadata->is_regular_file)
 		{
-			extension = absolute_path.extension().string();
-			std::ifstream is(absolute_path, std::ios::in | std::ios::binary);
-			if (!is)
+			extension = GetExtension(*relative_path);
+			// File content is read by caller (blocking or asynchronously).
+			prepared.file_path = variant ? variant->path : std::move(*relative_path);
+			prepared.file_size = entity.size;
+			rep.SetHeader("ETag", entity.etag);
+			rep.SetHeader("Last-Modified", entity.last_modified);
+			if (variant)
 			{
-				return StockResponse(StatusCode::NotFound);
+				rep.SetHeader("Content-Encoding", std::string{ConvertToString(variant->encoding)});
+			}
+			if (has_variants)
+			{
+				rep.SetHeader("Vary", "Accept-Encoding");
 			}
-
-			// Fill out the reply to be sent to the client.
-			is.seekg(0, is.end);
-			const size_t file_size = is.tellg();
-			is.seekg(0, is.beg);
-
-			std::string content;
-			content.resize(file_size);
-			is.read(content.data(), file_size);
-			rep.SetBody(std::move(content));
 		}
 		else
 		{
 			return StockResponse(StatusCode::NotFound);
 		}
 
-		if (http_req.IsKeepAlive())
-		{
-			rep.SetHeader("Connection", "keep-alive");
-		}
 		rep.SetHeader("Content-Type", GetTypeByExt(extension));
 
-		return rep;
+		return prepared;
 	}
 	catch (const std::exception& exc)
 	{
@@ -174,4 +304,106 @@ HttpResponse RequestHandler::HandleRequest(const HttpRequest& http_req)
 	return StockResponse(StatusCode::InternalServerError);
 }
 
+int RequestHandler::OpenResponseFile(PreparedResponse& prepared) const
+{
+	const auto fd = OpenFile(*prepared.file_path, O_RDONLY);
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	// Cache only saves stat before open, served entity is described by opened file.
+	struct stat st{};
+	if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		::close(fd);
+		return -1;
+	}
+	prepared.file_size = static_cast<size_t>(st.st_size);
+	auto etag = MakeETag(st);
+	const auto& headers = prepared.response.GetHeaders();
+	const auto etag_it = headers.find("ETag");
+	if (etag_it == headers.cend() || etag_it->second != etag)
+	{
+		prepared.response.SetHeader("ETag", std::move(etag));
+		prepared.response.SetHeader("Last-Modified", FormatHttpDate(st.st_mtim.tv_sec));
+	}
+	return fd;
+}
+
+int RequestHandler::OpenFile(const std::string& path, const int flags) const
+{
+	return OpenBeneath(root_fd_, path, flags);
+}
+
+std::optional<std::string> RequestHandler::ListDirectory(
+	const std::string& relative_path,
+	const std::string& request_path,
+	const bool is_root) const
+{
+	const auto fd = OpenFile(relative_path, O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+	{
+		return std::nullopt;
+	}
+
+	// Directory stream owns descriptor.
+	std::unique_ptr<DIR, DirectoryCloser> directory{::fdopendir(fd)};
+	if (!directory)
+	{
+		::close(fd);
+		return std::nullopt;
+	}
+
+	std::string htmp_to_return = "<html>";
+	htmp_to_return += "<head><title> Index of " + request_path + "</title></head>\n<body>\n";
+	htmp_to_return += "<h1>Index of " + request_path + "</h1><hr><pre>\n";
+	if (!is_root)
+	{
+		htmp_to_return += "<a href=\"../\">../</a>\n";
+	}
+
+	while (const auto* entry = ::readdir(directory.get()))
+	{
+		const std::string_view filename{entry->d_name};
+		if (filename == "." || filename == "..")
+		{
+			continue;
+		}
+		htmp_to_return += "<a href=\"";
+		htmp_to_return += filename;
+		htmp_to_return += "\">";
+		htmp_to_return += filename;
+		htmp_to_return += "</a>\n";
+	}
+	htmp_to_return += "</pre><hr></body>\n</html>";
+	return htmp_to_return;
+}
+
+bool RequestHandler::IsNotModified(const HttpRequest& http_req, const FileMetadata& metadata)
+{
+	const auto method = http_req.GetMethodType();
+	if (method != HttpMethodType::Get && method != HttpMethodType::Head)
+	{
+		return false;
+	}
+
+	const auto& headers = http_req.GetHeaders();
+
+	// If-None-Match takes precedence over If-Modified-Since (RFC 7232 6).
+	const auto if_none_match_it = headers.find("If-None-Match");
+	if (if_none_match_it != headers.cend())
+	{
+		return MatchEntityTag(if_none_match_it->second, metadata.etag);
+	}
+
+	const auto if_modified_since_it = headers.find("If-Modified-Since");
+	if (if_modified_since_it != headers.cend())
+	{
+		const auto since = ParseHttpDate(if_modified_since_it->second);
+		return since && metadata.modification_time <= *since;
+	}
+	return false;
+}
+
 } // namespace Http::Server
@@ -474,4 +474,9 @@ std::optional<HttpRequest> HttpRequestParser::PopHttpRequest() noexcept
 	};
 }
 
+bool HttpRequestParser::IsHeadersParsed() const noexcept
+{
+	return state_ == State::Body || state_ == State::Parsed;
+}
+
 } // namespace Http::Server
@@ -0,0 +1,386 @@
+#include <CustomServer/ResponseCompressor.hpp>
+
+#include <CustomServer/CompressionStream.hpp>
+
+#include <Http/HttpRequest.hpp>
+#include <Http/HttpResponse.hpp>
+#include <Http/Uri.hpp>
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+
+namespace Http::Server
+{
+
+namespace
+{
+
+//! Body is passed to compressor by pieces of this size.
+constexpr size_t input_chunk_size = 65536;
+
+//! Content codings which could be produced, ordered by server preference.
+constexpr std::array<ContentEncoding, 3> supported_encodings = {
+	ContentEncoding::Zstd,
+	ContentEncoding::Gzip,
+	ContentEncoding::Deflate,
+};
+
+// Entity tag of compressed representation, e.g. "abc" -> "abc-gzip".
+std::string MakeEncodedETag(const std::string& etag, const ContentEncoding encoding)
+{
+	if (etag.size() < 2 || etag.back() != '"')
+	{
+		return etag;
+	}
+	return etag.substr(0, etag.size() - 1) + "-" + std::string{ConvertToString(encoding)} + "\"";
+}
+
+const std::string* FindHeader(const HeadersMap& headers, const std::string& key)
+{
+	const auto it = headers.find(key);
+	return it != headers.cend() ? &it->second : nullptr;
+}
+
+// Add Accept-Encoding to Vary, keeping fields the response already varies on.
+void AddVaryAcceptEncoding(HttpResponse& response)
+{
+	const auto* vary = FindHeader(response.GetHeaders(), "Vary");
+	if (!vary || vary->empty())
+	{
+		response.SetHeader("Vary", "Accept-Encoding");
+	}
+	else if (*vary != "*" && !ContainsToken(*vary, "Accept-Encoding"))
+	{
+		response.SetHeader("Vary", *vary + ", Accept-Encoding");
+	}
+}
+
+} // namespace
+
+ResponseCompressor::ResponseCompressor(CompressionOptions options)
+	: options_(std::move(options))
+{
+}
+
+bool ResponseCompressor::Compress(const HttpRequest& request, HttpResponse& response)
+{
+	switch (PrepareCompression(request, response, response.GetBody().size()))
+	{
+	case PendingCompression::None:
+		return false;
+	case PendingCompression::Done:
+		// Cached compressed body or 304.
+		return response.GetStatusCode() == StatusCode::Ok;
+	case PendingCompression::NeedsBody:
+		break;
+	}
+	CompressPrepared(request, response, response.GetBody());
+	return true;
+}
+
+PendingCompression ResponseCompressor::PrepareCompression(
+	const HttpRequest& request,
+	HttpResponse& response,
+	const uint64_t body_size)
+{
+	if (!options_.enabled)
+	{
+		return PendingCompression::None;
+	}
+
+	const auto& headers = response.GetHeaders();
+	const auto* etag = FindHeader(headers, "ETag");
+
+	// Client revalidates compressed representation, keep its entity tag.
+	if (response.GetStatusCode() == StatusCode::NotModified)
+	{
+		const auto encoding = SelectEncoding(request);
+		const auto* if_none_match = FindHeader(request.GetHeaders(), "If-None-Match");
+		if (etag && if_none_match && encoding != ContentEncoding::Identity)
+		{
+			auto encoded_etag = MakeEncodedETag(*etag, encoding);
+			if (MatchEntityTag(*if_none_match, encoded_etag))
+			{
+				response.SetHeader("ETag", std::move(encoded_etag));
+				AddVaryAcceptEncoding(response);
+			}
+		}
+		return PendingCompression::None;
+	}
+
+	if (!IsCompressible(response, body_size))
+	{
+		return PendingCompression::None;
+	}
+
+	// Response depends on Accept-Encoding even if it isn't compressed for this client.
+	AddVaryAcceptEncoding(response);
+
+	const auto encoding = SelectEncoding(request);
+	if (encoding == ContentEncoding::Identity)
+	{
+		return PendingCompression::None;
+	}
+
+	// Compressed representation is revalidated only by its own tag, which this request would get.
+	const auto* if_none_match = FindHeader(request.GetHeaders(), "If-None-Match");
+	const auto method = request.GetMethodType();
+	if (etag
+		&& if_none_match
+		&& (method == HttpMethodType::Get || method == HttpMethodType::Head)
+		&& MatchEntityTag(*if_none_match, MakeEncodedETag(*etag, encoding)))
+	{
+		HttpResponse not_modified{StatusCode::NotModified};
+		not_modified.SetHeader("ETag", MakeEncodedETag(*etag, encoding));
+		if (const auto* last_modified = FindHeader(headers, "Last-Modified"))
+		{
+			not_modified.SetHeader("Last-Modified", *last_modified);
+		}
+		if (const auto* vary = FindHeader(headers, "Vary"))
+		{
+			not_modified.SetHeader("Vary", *vary);
+		}
+		response = std::move(not_modified);
+		return PendingCompression::Done;
+	}
+
+	// Cache hit doesn't need body at all, so file isn't read.
+	const auto cache_key = MakeCacheKey(request, response, encoding);
+	if (!cache_key)
+	{
+		return PendingCompression::NeedsBody;
+	}
+	auto body = FindInCache(*cache_key);
+	if (!body)
+	{
+		return PendingCompression::NeedsBody;
+	}
+	SetEncodedHeaders(response, encoding);
+	// Cached body is shared by all responses, it isn't copied.
+	response.SetSharedBody(std::move(body));
+	return PendingCompression::Done;
+}
+
+void ResponseCompressor::CompressPrepared(const HttpRequest& request, HttpResponse& response, std::string body)
+{
+	const auto encoding = SelectEncoding(request);
+	auto cache_key = MakeCacheKey(request, response, encoding);
+	SetEncodedHeaders(response, encoding);
+
+	// Response to HEAD needs length of compressed body, small bodies are compressed by one chunk anyway.
+	if (request.GetMethodType() == HttpMethodType::Head || body.size() <= input_chunk_size)
+	{
+		auto compressed = std::make_shared<const std::string>(CompressBody(body, encoding));
+		if (cache_key)
+		{
+			AddToCache(*cache_key, compressed);
+		}
+		response.SetSharedBody(std::move(compressed));
+		return;
+	}
+	response.SetGeneratedBody(MakeCompressingGenerator(std::move(body), encoding, std::move(cache_key)));
+}
+
+bool ResponseCompressor::IsCompressible(const HttpResponse& response, const uint64_t body_size) const
+{
+	if (response.GetStatusCode() != StatusCode::Ok || body_size < options_.min_size)
+	{
+		return false;
+	}
+
+	const auto& headers = response.GetHeaders();
+	if (FindHeader(headers, "Content-Encoding"))
+	{
+		return false;
+	}
+
+	const auto* cache_control = FindHeader(headers, "Cache-Control");
+	if (cache_control && cache_control->find("no-transform") != std::string::npos)
+	{
+		return false;
+	}
+
+	const auto* content_type = FindHeader(headers, "Content-Type");
+	if (!content_type)
+	{
+		return false;
+	}
+	return std::any_of(
+		options_.content_types.cbegin(),
+		options_.content_types.cend(),
+		[content_type](const auto& prefix) { return content_type->compare(0, prefix.size(), prefix) == 0; });
+}
+
+ContentEncoding ResponseCompressor::SelectEncoding(const HttpRequest& request)
+{
+	const auto* accept_encoding_header = FindHeader(request.GetHeaders(), "Accept-Encoding");
+	if (!accept_encoding_header)
+	{
+		return ContentEncoding::Identity;
+	}
+
+	const AcceptEncoding accept_encoding{*accept_encoding_header};
+	auto best_encoding = ContentEncoding::Identity;
+	unsigned best_quality = 0;
+	for (const auto encoding : supported_encodings)
+	{
+		const auto quality = accept_encoding.GetQuality(encoding);
+		if (quality > best_quality && CompressionStream::IsSupported(encoding))
+		{
+			best_encoding = encoding;
+			best_quality = quality;
+		}
+	}
+	return best_encoding;
+}
+
+std::optional<std::string> ResponseCompressor::MakeCacheKey(
+	const HttpRequest& request,
+	const HttpResponse& response,
+	const ContentEncoding encoding) const
+{
+	const auto* etag = FindHeader(response.GetHeaders(), "ETag");
+	if (!etag || options_.cache_size == 0)
+	{
+		return std::nullopt;
+	}
+
+	// Cache key is (decoded path, ETag, encoding): query string doesn't change entity with the same tag.
+	auto cache_key = PercentDecode(request.GetUriView().GetPath());
+	if (cache_key)
+	{
+		*cache_key += '\n';
+		*cache_key += *etag;
+		*cache_key += '\n';
+		*cache_key += ConvertToString(encoding);
+	}
+	return cache_key;
+}
+
+void ResponseCompressor::SetEncodedHeaders(HttpResponse& response, const ContentEncoding encoding)
+{
+	const auto* etag = FindHeader(response.GetHeaders(), "ETag");
+	if (etag)
+	{
+		response.SetHeader("ETag", MakeEncodedETag(*etag, encoding));
+	}
+	response.SetHeader("Content-Encoding", std::string{ConvertToString(encoding)});
+}
+
+std::string ResponseCompressor::CompressBody(const std::string& body, const ContentEncoding encoding) const
+{
+	CompressionStream stream{encoding, options_.level};
+	std::string compressed;
+	compressed.reserve(body.size() / 2);
+
+	const std::string_view input{body};
+	for (size_t offset = 0; offset < input.size(); offset += input_chunk_size)
+	{
+		stream.Write(input.substr(offset, input_chunk_size), compressed);
+	}
+	stream.Finish(compressed);
+	return compressed;
+}
+
+BodyGenerator ResponseCompressor::MakeCompressingGenerator(
+	std::string body,
+	const ContentEncoding encoding,
+	std::optional<std::string> cache_key)
+{
+	struct GeneratorState final
+	{
+		std::string input;
+		size_t offset = 0;
+		CompressionStream stream;
+		bool finished = false;
+		//! Key of cached output, reset if output doesn't fit cache.
+		std::optional<std::string> cache_key;
+		std::string cached;
+	};
+	auto state = std::make_shared<GeneratorState>(
+		GeneratorState{std::move(body), 0, CompressionStream{encoding, options_.level}, false, std::move(cache_key), {}});
+
+	// Next input chunk is compressed only after previous output is written to socket.
+	auto generate = [this, state]() -> std::optional<std::string>
+	{
+		std::string output;
+		while (output.empty() && !state->finished)
+		{
+			if (state->offset < state->input.size())
+			{
+				state->stream.Write(std::string_view{state->input}.substr(state->offset, input_chunk_size), output);
+				state->offset += input_chunk_size;
+			}
+			else
+			{
+				state->stream.Finish(output);
+				state->finished = true;
+				state->input = {};
+			}
+		}
+
+		// Output is copied to cache while it fits.
+		if (state->cache_key && state->cached.size() + output.size() <= options_.cache_size)
+		{
+			state->cached += output;
+		}
+		else if (state->cache_key)
+		{
+			state->cache_key.reset();
+			state->cached = {};
+		}
+		if (state->finished && state->cache_key)
+		{
+			AddToCache(*state->cache_key, std::make_shared<const std::string>(std::move(state->cached)));
+			state->cache_key.reset();
+		}
+
+		return output.empty() ? std::nullopt : std::optional<std::string>{std::move(output)};
+	};
+	return BodyGenerator{std::move(generate), std::nullopt};
+}
+
+std::shared_ptr<const std::string> ResponseCompressor::FindInCache(const std::string& key)
+{
+	std::lock_guard lock{cache_mutex_};
+	const auto it = cache_index_.find(key);
+	if (it == cache_index_.cend())
+	{
+		return nullptr;
+	}
+	cache_list_.splice(cache_list_.begin(), cache_list_, it->second);
+	return it->second->body;
+}
+
+void ResponseCompressor::AddToCache(const std::string& key, std::shared_ptr<const std::string> body)
+{
+	if (body->size() > options_.cache_size)
+	{
+		return;
+	}
+
+	std::lock_guard lock{cache_mutex_};
+	if (cache_index_.count(key) != 0)
+	{
+		return;
+	}
+
+	cache_bytes_ += body->size();
+	cache_list_.push_front(CacheEntry{key, std::move(body)});
+	cache_index_.emplace(key, cache_list_.begin());
+
+	while (cache_bytes_ > options_.cache_size)
+	{
+		auto& last = cache_list_.back();
+		cache_bytes_ -= last.body->size();
+		cache_index_.erase(last.key);
+		cache_list_.pop_back();
+	}
+}
+
+} // namespace Http::Server
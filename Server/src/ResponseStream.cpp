@@ -0,0 +1,127 @@
+#include <CustomServer/ResponseStream.hpp>
+
+#include <CustomServer/Connection.hpp>
+
+#include <cstdio>
+#include <iostream>
+#include <utility>
+
+
+namespace Http::Server
+{
+
+namespace
+{
+
+constexpr const char* crlf = "\r\n";
+//! Last chunk without trailers.
+constexpr const char* last_chunk = "0\r\n\r\n";
+
+} // namespace
+
+ResponseStream::ResponseStream(
+	ConnectionPtr connection,
+	const bool chunked,
+	const bool headers_only,
+	const bool keep_alive) noexcept
+	: connection_(std::move(connection))
+	, chunked_(chunked)
+	, headers_only_(headers_only)
+	, keep_alive_(keep_alive)
+{
+}
+
+ResponseStream::ResponseStream(ResponseStream&& other) noexcept
+	: connection_(std::move(other.connection_))
+	, chunked_(other.chunked_)
+	, headers_only_(other.headers_only_)
+	, keep_alive_(other.keep_alive_)
+	, finished_(other.finished_)
+{
+}
+
+ResponseStream& ResponseStream::operator=(ResponseStream&& other) noexcept
+{
+	if (this != &other)
+	{
+		Abort();
+		connection_ = std::move(other.connection_);
+		chunked_ = other.chunked_;
+		headers_only_ = other.headers_only_;
+		keep_alive_ = other.keep_alive_;
+		finished_ = other.finished_;
+	}
+	return *this;
+}
+
+bool ResponseStream::Write(std::string data, WriteHandler handler)
+{
+	if (!connection_ || finished_)
+	{
+		return false;
+	}
+
+	// Empty chunk means end of body, so empty data is only passed for handler call.
+	if (headers_only_ || data.empty())
+	{
+		return connection_->Write({}, WriteCompletion::None, std::move(handler));
+	}
+
+	if (!chunked_)
+	{
+		return connection_->Write(std::move(data), WriteCompletion::None, std::move(handler));
+	}
+
+	char size[24];
+	const auto size_length = std::snprintf(size, sizeof(size), "%zx\r\n", data.size());
+	std::string chunk;
+	chunk.reserve(static_cast<size_t>(size_length) + data.size() + 2);
+	chunk.append(size, static_cast<size_t>(size_length));
+	chunk += data;
+	chunk += crlf;
+	return connection_->Write(std::move(chunk), WriteCompletion::None, std::move(handler));
+}
+
+bool ResponseStream::Finish(WriteHandler handler)
+{
+	if (!connection_ || finished_)
+	{
+		return false;
+	}
+
+	finished_ = true;
+	return connection_->Write(
+		chunked_ && !headers_only_ ? last_chunk : std::string{},
+		keep_alive_ ? WriteCompletion::KeepAlive : WriteCompletion::Close,
+		std::move(handler));
+}
+
+bool ResponseStream::IsWriteQueueFull() const noexcept
+{
+	return connection_ && connection_->IsWriteQueueFull();
+}
+
+ResponseStream::~ResponseStream()
+{
+	Abort();
+}
+
+void ResponseStream::Abort() noexcept
+{
+	if (!connection_ || finished_)
+	{
+		return;
+	}
+
+	// Client can detect incomplete response only by closed connection.
+	try
+	{
+		finished_ = connection_->Write({}, WriteCompletion::Close);
+	}
+	catch (const std::exception& exc)
+	{
+		std::cerr << "Can't abort response stream: " << exc.what() << std::endl;
+	}
+}
+
+} // namespace Http::Server
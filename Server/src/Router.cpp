@@ -0,0 +1,370 @@
+#include <CustomServer/Router.hpp>
+
+#include <Http/HttpRequest.hpp>
+#include <Http/HttpResponse.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+
+namespace Http::Server
+{
+
+static_assert(static_cast<size_t>(HttpMethodType::Unknown) <= 32, "Allowed methods are bits of uint32_t");
+
+std::optional<std::string_view> RouteParameters::Find(const std::string_view name) const noexcept
+{
+	for (size_t i = 0; i < size_; ++i)
+	{
+		if (parameters_[i].name == name)
+		{
+			return parameters_[i].value;
+		}
+	}
+	return std::nullopt;
+}
+
+size_t RouteParameters::Size() const noexcept
+{
+	return size_;
+}
+
+const RouteParameters::Parameter& RouteParameters::operator[](const size_t index) const noexcept
+{
+	return parameters_[index];
+}
+
+Router::Match Router::Find(const HttpMethodType method, const std::string_view path) const noexcept
+{
+	Match match;
+	if (static_cast<size_t>(method) >= methods_count)
+	{
+		return match;
+	}
+
+	// Fast path for routes without captures.
+	const auto static_it = static_routes_.find(path);
+	if (static_it != static_routes_.cend() && SetMatch(static_it->second, method, match))
+	{
+		return match;
+	}
+
+	if (!nodes_.empty())
+	{
+		FindInNode(0, method, path, match);
+	}
+	return match;
+}
+
+void Router::operator()(HttpRequestConnectionUPtr http_request) const
+{
+	if (!http_request)
+	{
+		return;
+	}
+
+	const auto& request = http_request->GetRequest();
+	const auto match = Find(request.GetMethodType(), request.GetUriView().GetPath());
+	switch (match.status)
+	{
+	case MatchStatus::Found:
+		(*match.handler)(std::move(http_request), match.parameters);
+		return;
+	case MatchStatus::MethodNotAllowed:
+	{
+		// 405 lists methods of target resource (RFC 7231 6.5.5).
+		std::string allow;
+		for (size_t method = 0; method < methods_count; ++method)
+		{
+			if ((match.allowed_methods & (uint32_t{1} << method)) != 0)
+			{
+				allow += allow.empty() ? "" : ", ";
+				allow += ConvertToString(static_cast<HttpMethodType>(method));
+			}
+		}
+		auto response = StockResponse(StatusCode::MethodNotAllowed);
+		response.SetHeader("Allow", std::move(allow));
+		http_request->Send(response);
+		return;
+	}
+	case MatchStatus::NotFound:
+	default:
+		http_request->Send(StockResponse(StatusCode::NotFound));
+		return;
+	}
+}
+
+Router::MethodHandlers Router::MakeEmptyHandlers() noexcept
+{
+	MethodHandlers handlers;
+	handlers.fill(npos);
+	return handlers;
+}
+
+bool Router::FindInNode(
+	const uint32_t node_index,
+	const HttpMethodType method,
+	const std::string_view path,
+	Match& match) const noexcept
+{
+	const auto& node = nodes_[node_index];
+	auto& parameters = match.parameters;
+
+	if (path.empty())
+	{
+		return SetMatch(node.handlers, method, match) || FindInWildcard(node, method, path, match);
+	}
+
+	// Literal children have priority over captures.
+	for (const auto child_index : node.children)
+	{
+		const auto& child = nodes_[child_index];
+		if (child.prefix.front() != path.front())
+		{
+			continue;
+		}
+		if (path.compare(0, child.prefix.size(), child.prefix) == 0
+			&& FindInNode(child_index, method, path.substr(child.prefix.size()), match))
+		{
+			return true;
+		}
+		break;
+	}
+
+	if (node.parameter_child != npos && parameters.size_ < RouteParameters::max_size)
+	{
+		const auto segment = path.substr(0, path.find('/'));
+		if (!segment.empty())
+		{
+			const auto& child = nodes_[node.parameter_child];
+			parameters.parameters_[parameters.size_++] = {child.parameter_name, segment};
+			if (FindInNode(node.parameter_child, method, path.substr(segment.size()), match))
+			{
+				return true;
+			}
+			--parameters.size_;
+		}
+	}
+
+	return FindInWildcard(node, method, path, match);
+}
+
+bool Router::FindInWildcard(
+	const Node& node,
+	const HttpMethodType method,
+	const std::string_view path,
+	Match& match) const noexcept
+{
+	auto& parameters = match.parameters;
+	if (node.wildcard_child == npos || parameters.size_ >= RouteParameters::max_size)
+	{
+		return false;
+	}
+
+	const auto& child = nodes_[node.wildcard_child];
+	parameters.parameters_[parameters.size_++] = {child.parameter_name, path};
+	if (SetMatch(child.handlers, method, match))
+	{
+		return true;
+	}
+	--parameters.size_;
+	return false;
+}
+
+bool Router::SetMatch(const MethodHandlers& handlers, const HttpMethodType method, Match& match) const noexcept
+{
+	const auto handler_index = handlers[static_cast<size_t>(method)];
+	if (handler_index != npos)
+	{
+		match.status = MatchStatus::Found;
+		match.handler = &handlers_[handler_index];
+		return true;
+	}
+
+	// Path is known, but other method is expected, methods of all routes matching path are allowed.
+	for (size_t other_method = 0; other_method < methods_count; ++other_method)
+	{
+		if (handlers[other_method] != npos)
+		{
+			match.status = MatchStatus::MethodNotAllowed;
+			match.allowed_methods |= uint32_t{1} << other_method;
+		}
+	}
+	return false;
+}
+
+RouterBuilder::RouterBuilder()
+{
+	router_.nodes_.emplace_back();
+}
+
+RouterBuilder& RouterBuilder::Add(const HttpMethodType method, std::string_view pattern, RouteHandler handler)
+{
+	const std::string full_pattern{pattern};
+	if (static_cast<size_t>(method) >= Router::methods_count)
+	{
+		throw std::runtime_error("Unknown method for route " + full_pattern);
+	}
+	if (pattern.empty() || pattern.front() != '/')
+	{
+		throw std::runtime_error("Route should start with '/': " + full_pattern);
+	}
+	if (!handler)
+	{
+		throw std::runtime_error("Route handler isn't set: " + full_pattern);
+	}
+
+	uint32_t node_index = 0;
+	size_t captures_count = 0;
+	while (!pattern.empty())
+	{
+		const auto capture_pos = pattern.find_first_of(":*");
+		node_index = InsertLiteral(node_index, pattern.substr(0, capture_pos));
+		if (capture_pos == std::string_view::npos)
+		{
+			break;
+		}
+		if (pattern[capture_pos - 1] != '/')
+		{
+			throw std::runtime_error("Capture should start path segment: " + full_pattern);
+		}
+
+		const auto wildcard = pattern[capture_pos] == '*';
+		pattern.remove_prefix(capture_pos + 1);
+		const auto name = pattern.substr(0, pattern.find('/'));
+		if (name.empty())
+		{
+			throw std::runtime_error("Capture name is empty: " + full_pattern);
+		}
+		if (wildcard && name.size() != pattern.size())
+		{
+			throw std::runtime_error("Wildcard should be last: " + full_pattern);
+		}
+		if (++captures_count > RouteParameters::max_size)
+		{
+			throw std::runtime_error("Too many captures: " + full_pattern);
+		}
+		node_index = InsertCapture(node_index, name, wildcard);
+		pattern.remove_prefix(name.size());
+	}
+
+	auto& handler_index = router_.nodes_[node_index].handlers[static_cast<size_t>(method)];
+	if (handler_index != Router::npos)
+	{
+		throw std::runtime_error("Route already exists: " + ConvertToString(method) + " " + full_pattern);
+	}
+	handler_index = static_cast<uint32_t>(router_.handlers_.size());
+	router_.handlers_.push_back(std::move(handler));
+
+	if (captures_count == 0)
+	{
+		auto [it, inserted] = static_routes_.try_emplace(full_pattern, Router::MakeEmptyHandlers());
+		it->second[static_cast<size_t>(method)] = handler_index;
+	}
+	return *this;
+}
+
+Router RouterBuilder::Build()
+{
+	// Paths are stored before map is filled, so views stay valid.
+	router_.static_paths_.reserve(static_routes_.size());
+	for (const auto& route : static_routes_)
+	{
+		router_.static_paths_.push_back(route.first);
+	}
+	for (const auto& path : router_.static_paths_)
+	{
+		router_.static_routes_.emplace(path, static_routes_.at(path));
+	}
+
+	auto router = std::move(router_);
+	router_ = Router{};
+	router_.nodes_.emplace_back();
+	static_routes_.clear();
+	return router;
+}
+
+uint32_t RouterBuilder::FindLiteralChild(const uint32_t node_index, const char first_char) const noexcept
+{
+	for (const auto child_index : router_.nodes_[node_index].children)
+	{
+		if (router_.nodes_[child_index].prefix.front() == first_char)
+		{
+			return child_index;
+		}
+	}
+	return Router::npos;
+}
+
+uint32_t RouterBuilder::InsertLiteral(uint32_t node_index, std::string_view literal)
+{
+	while (!literal.empty())
+	{
+		const auto child_index = FindLiteralChild(node_index, literal.front());
+		if (child_index == Router::npos)
+		{
+			Router::Node child;
+			child.prefix = std::string{literal};
+			const auto new_index = AddNode(std::move(child));
+			router_.nodes_[node_index].children.push_back(new_index);
+			return new_index;
+		}
+
+		auto& child = router_.nodes_[child_index];
+		const auto common_size = static_cast<size_t>(std::mismatch(
+			child.prefix.cbegin(),
+			child.prefix.cend(),
+			literal.cbegin(),
+			literal.cend()).first - child.prefix.cbegin());
+
+		if (common_size < child.prefix.size())
+		{
+			// Split child: tail of prefix moves into new node with all child subtree.
+			Router::Node tail;
+			tail.prefix = child.prefix.substr(common_size);
+			tail.children = std::move(child.children);
+			tail.parameter_child = std::exchange(child.parameter_child, Router::npos);
+			tail.wildcard_child = std::exchange(child.wildcard_child, Router::npos);
+			tail.handlers = std::exchange(child.handlers, Router::MakeEmptyHandlers());
+			child.prefix.resize(common_size);
+			child.children.clear();
+
+			const auto tail_index = AddNode(std::move(tail));
+			router_.nodes_[child_index].children.push_back(tail_index);
+		}
+
+		node_index = child_index;
+		literal.remove_prefix(common_size);
+	}
+	return node_index;
+}
+
+uint32_t RouterBuilder::InsertCapture(const uint32_t node_index, const std::string_view name, const bool wildcard)
+{
+	const auto& node = router_.nodes_[node_index];
+	const auto child_index = wildcard ? node.wildcard_child : node.parameter_child;
+	if (child_index != Router::npos)
+	{
+		if (router_.nodes_[child_index].parameter_name != name)
+		{
+			throw std::runtime_error("Conflicting capture names " + router_.nodes_[child_index].parameter_name + " and " + std::string{name});
+		}
+		return child_index;
+	}
+
+	Router::Node child;
+	child.parameter_name = std::string{name};
+	const auto new_index = AddNode(std::move(child));
+	auto& parent = router_.nodes_[node_index];
+	(wildcard ? parent.wildcard_child : parent.parameter_child) = new_index;
+	return new_index;
+}
+
+uint32_t RouterBuilder::AddNode(Router::Node node)
+{
+	router_.nodes_.push_back(std::move(node));
+	return static_cast<uint32_t>(router_.nodes_.size() - 1);
+}
+
+} // namespace Http::Server
@@ -1,8 +1,16 @@
 #include <CustomServer/Server.hpp>
 
 #include <CustomServer/Connection.hpp>
+#include <CustomServer/ListenerHandoff.hpp>
 
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <csignal>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <string>
@@ -14,22 +22,56 @@
 namespace Http::Server
 {
 
+namespace
+{
+
+// Accepted socket options, which are renewed by connection.
+ConnectionOptions MakeConnectionOptions(ConnectionOptions options, const ListenerOptions& listener_options)
+{
+	options.quick_ack = options.quick_ack || listener_options.quick_ack;
+	return options;
+}
+
+} // namespace
+
 Server::Server(
 	const size_t thread_count,
 	const std::string& address,
 	const std::string& port,
-	std::function<void(HttpRequestConnectionUPtr)> request_handler)
+	RequestHandlerRef request_handler,
+	const ConnectionOptions& connection_options,
+	const AdmissionOptions& admission_options,
+	const ListenerOptions& listener_options,
+	const PlacementOptions& placement_options)
 	: thread_count_(thread_count)
-	, strand_(io_context_)
+	// Io threads and accepting thread have own counter shards.
+	, state_(admission_options, thread_count + 1)
 	, signals_(io_context_)
 	, acceptor_(io_context_)
-	, request_handler_(std::move(request_handler))
+	, handoff_acceptor_(io_context_)
+	, accept_timer_(io_context_)
+	, request_handler_(request_handler)
+	, connection_options_(MakeConnectionOptions(connection_options, listener_options))
+	, listener_options_(listener_options)
+	, placement_options_(placement_options)
 
 {
 	if (thread_count_ == 0)
 	{
 		throw std::runtime_error("Thread count should be more than 0 for http server");
 	}
+
+	workers_.reserve(thread_count_);
+	for (size_t i = 0; i < thread_count_; ++i)
+	{
+		auto& worker = *workers_.emplace_back(std::make_unique<Worker>());
+		worker.work.emplace(boost::asio::make_work_guard(worker.io_context));
+		if (!placement_options_.cpus.empty())
+		{
+			worker.cpu = placement_options_.cpus[i % placement_options_.cpus.size()];
+		}
+	}
+
 	// Register to handle the signals that indicate when the server should exit.
 	// It is safe to register for the same signal multiple times in a program,
 	// provided all registration for the specified signal is made through Asio.
@@ -39,9 +81,13 @@ Server::Server(
 	signals_.add(SIGQUIT);
 #endif // defined(SIGQUIT)
 	signals_.async_wait(
-		boost::asio::bind_executor(strand_,
 		[this](boost::system::error_code ec, int signo)
 		{
+			// Waiting is canceled when listener is handed off to new server.
+			if (ec == boost::asio::error::operation_aborted)
+			{
+				return;
+			}
 			if (ec)
 			{
 				std::cerr << "Got some error while was waiting signal: " << ec.message();
@@ -49,19 +95,47 @@ Server::Server(
 			}
 
 			std::cout << "Got signal " << signo << std::endl;
-			if (state_.Stop())
-			{
-				acceptor_.close();
-			}
-		}));
+			Shutdown();
+		});
 
-	// Open the acceptor with the option to reuse the address (i.e. SO_REUSEADDR).
-	boost::asio::ip::tcp::resolver resolver(acceptor_.get_executor());
-	boost::asio::ip::tcp::endpoint endpoint = *resolver.resolve(address, port).begin();
-	acceptor_.open(endpoint.protocol());
-	acceptor_.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
-	acceptor_.bind(endpoint);
-	acceptor_.listen();
+	// Listener of previous server is used, so connections aren't refused during restart.
+	const auto inherited_listener = TakeInheritedListener();
+	std::optional<HandedOffListener> handed_off;
+	if (listener_options_.listener_fd >= 0)
+	{
+		AssignAcceptor(acceptor_, listener_options_.listener_fd, listener_options_);
+	}
+	else if (inherited_listener >= 0)
+	{
+		std::cout << "Use inherited listener" << std::endl;
+		AssignAcceptor(acceptor_, inherited_listener, listener_options_);
+	}
+	else if (!listener_options_.handoff_path.empty()
+		&& (handed_off = RequestListener(listener_options_.handoff_path)))
+	{
+		std::cout << "Use listener of running server" << std::endl;
+		previous_server_channel_ = handed_off->channel;
+		AssignAcceptor(acceptor_, handed_off->listener, listener_options_);
+	}
+	else
+	{
+		boost::asio::ip::tcp::resolver resolver(acceptor_.get_executor());
+		boost::asio::ip::tcp::endpoint endpoint = *resolver.resolve(address, port).begin();
+		OpenAcceptor(acceptor_, endpoint, listener_options_);
+	}
+	// Pending connections are accepted until EAGAIN.
+	acceptor_.non_blocking(true);
+
+	if (!listener_options_.handoff_path.empty())
+	{
+		// Socket file belongs to previous server or is stale, next server connects to this one.
+		::unlink(listener_options_.handoff_path.c_str());
+		const boost::asio::local::stream_protocol::endpoint handoff_endpoint(listener_options_.handoff_path);
+		handoff_acceptor_.open(handoff_endpoint.protocol());
+		handoff_acceptor_.bind(handoff_endpoint);
+		handoff_acceptor_.listen();
+		StartHandoff();
+	}
 
 	StartAccept();
 }
@@ -70,17 +144,64 @@ void Server::Run()
 {
 	work_threads_.reserve(thread_count_);
 
-	for (size_t i = 0; i < thread_count_; ++i)
+	for (auto& worker : workers_)
 	{
-		work_threads_.emplace_back([&io_context = io_context_]() {io_context.run();});
+		work_threads_.emplace_back(
+			[&worker = *worker, shard = work_threads_.size()]()
+			{
+				State::BindCurrentThread(shard);
+				if (worker.cpu && !PinCurrentThread(*worker.cpu))
+				{
+					std::cerr << "Can't pin io thread to CPU " << *worker.cpu << std::endl;
+				}
+				worker.io_context.run();
+			});
+	}
+	State::BindCurrentThread(thread_count_);
+	if (placement_options_.accept_cpu && !PinCurrentThread(*placement_options_.accept_cpu))
+	{
+		std::cerr << "Can't pin accepting thread to CPU " << *placement_options_.accept_cpu << std::endl;
+	}
+
+	if (previous_server_channel_ >= 0)
+	{
+		ConfirmListener(std::exchange(previous_server_channel_, -1));
+	}
+
+	// Accepting is finished when server is stopped, io threads exit after their connections.
+	io_context_.run();
+	const auto deadline = std::chrono::steady_clock::now() + connection_options_.drain_timeout;
+	if (!state_.WaitConnectionsClosed(deadline))
+	{
+		std::cerr << "Drop " << state_.ConnectionCount() << " connections after shutdown timeout" << std::endl;
+		for (auto& worker : workers_)
+		{
+			worker->io_context.stop();
+		}
 	}
 
 	for (auto& thread : work_threads_)
 	{
 		thread.join();
 	}
+}
 
-	while (state_.HasConnections());
+State& Server::GetState() noexcept
+{
+	return state_;
+}
+
+const State& Server::GetState() const noexcept
+{
+	return state_;
+}
+
+AcceptStats Server::GetAcceptStats()
+{
+	auto stats = state_.GetAcceptStats();
+	stats.queue_length = GetAcceptQueueLength(acceptor_);
+	stats.listen_overflows = GetListenOverflows();
+	return stats;
 }
 
 void Server::StartAccept()
@@ -90,25 +211,269 @@ void Server::StartAccept()
 		return;
 	}
 
-	auto new_connection = Connection::CreateHttpConnection(state_, io_context_, request_handler_);
-	acceptor_.async_accept(
-		new_connection->GetSocket(),
-		boost::asio::bind_executor(strand_,
-		[connection = new_connection, this](const boost::system::error_code& e)
+	// Above connections limit new clients wait in listen backlog, served clients keep bounded latency.
+	if (!state_.CanAcceptConnection())
+	{
+		PauseAccept();
+		return;
+	}
+
+	acceptor_.async_wait(
+		boost::asio::ip::tcp::acceptor::wait_read,
+		[this](const boost::system::error_code& ec)
 		{
-			if (e)
+			if (ec)
 			{
-				if (e == boost::asio::error::operation_aborted)
+				if (ec == boost::asio::error::operation_aborted)
 				{
-					std::cerr << "Accpetor was closed: " << e.message() << std::endl;
+					std::cerr << "Accpetor was closed: " << ec.message() << std::endl;
 					return;
 				}
-				std::cerr << "Accpetor error: " << e.message() << std::endl;
+				std::cerr << "Accpetor error: " << ec.message() << std::endl;
+				state_.AddAcceptError();
+				PauseAccept();
+				return;
+			}
+
+			if (!AcceptBatch())
+			{
+				PauseAccept();
+				return;
 			}
-			connection->Start();
 			StartAccept();
+		});
+}
+
+void Server::PauseAccept()
+{
+	state_.AddAcceptPause();
+	accept_timer_.expires_after(state_.GetAdmissionOptions().accept_pause);
+	accept_timer_.async_wait(
+		[this](const boost::system::error_code& ec)
+		{
+			if (!ec)
+			{
+				StartAccept();
+			}
+		});
+}
+
+bool Server::AcceptBatch()
+{
+	const auto protocol = acceptor_.local_endpoint().protocol();
+	size_t accepted = 0;
+	auto can_accept = true;
+	while (accepted < listener_options_.max_accept_batch)
+	{
+		if (!state_.CanAcceptConnection())
+		{
+			can_accept = false;
+			break;
 		}
-	));
+
+		const auto fd = ::accept4(acceptor_.native_handle(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd >= 0)
+		{
+			++accepted;
+			PassConnection(fd, protocol);
+			continue;
+		}
+
+		const auto error = errno;
+		// Client could reset connection while it waited in accept queue.
+		if (error == EINTR || error == ECONNABORTED)
+		{
+			continue;
+		}
+		if (error == EAGAIN || error == EWOULDBLOCK)
+		{
+			break;
+		}
+		std::cerr << "Can't accept connection: " << std::strerror(error) << std::endl;
+		state_.AddAcceptError();
+		// Listener stays readable while descriptors or memory are exhausted, so waiting would spin.
+		can_accept = false;
+		break;
+	}
+
+	state_.AddAcceptBatch(accepted);
+	return can_accept;
+}
+
+void Server::PassConnection(const int fd, const boost::asio::ip::tcp& protocol)
+{
+	auto& worker = SelectWorker(fd);
+	boost::asio::post(
+		worker.io_context,
+		[this, &worker, fd, protocol]()
+		{
+			StartConnection(worker, fd, protocol);
+		});
+}
+
+void Server::StartConnection(Worker& worker, const int fd, const boost::asio::ip::tcp& protocol)
+{
+	auto connection = Connection::CreateHttpConnection(
+		state_,
+		worker.io_context,
+		request_handler_,
+		connection_options_,
+		&worker.connections);
+
+	boost::system::error_code ec;
+	connection->GetSocket().assign(protocol, fd, ec);
+	if (ec)
+	{
+		std::cerr << "Can't assign accepted socket: " << ec.message() << std::endl;
+		::close(fd);
+		return;
+	}
+	if (const auto options_ec = ApplyAcceptedSocketOptions(connection->GetSocket(), listener_options_))
+	{
+		std::cerr << "Can't set socket options: " << options_ec.message() << std::endl;
+	}
+
+	// Closed connections are removed from time to time, so list size is proportional to open connections.
+	auto& started_connections = worker.started_connections;
+	if (started_connections.size() >= 2 * std::max<size_t>(worker.connections, 64))
+	{
+		started_connections.erase(
+			std::remove_if(
+				started_connections.begin(),
+				started_connections.end(),
+				[](const auto& started_connection)
+				{
+					return started_connection.expired();
+				}),
+			started_connections.end());
+	}
+	started_connections.push_back(connection);
+	connection->Start();
+}
+
+Server::Worker& Server::SelectWorker(const int fd) noexcept
+{
+	if (listener_options_.balancing == AcceptBalancing::LeastLoaded)
+	{
+		return **std::min_element(
+			workers_.begin(),
+			workers_.end(),
+			[](const auto& lhs, const auto& rhs)
+			{
+				return lhs->connections < rhs->connections;
+			});
+	}
+
+	// Packets and connection are handled by the same CPU, so connection data stays in its cache.
+	if (listener_options_.balancing == AcceptBalancing::IncomingCpu)
+	{
+		if (const auto cpu = GetIncomingCpu(fd))
+		{
+			const auto worker = std::find_if(
+				workers_.begin(),
+				workers_.end(),
+				[cpu](const auto& worker)
+				{
+					return worker->cpu == cpu;
+				});
+			if (worker != workers_.end())
+			{
+				return **worker;
+			}
+		}
+	}
+
+	auto& worker = *workers_[next_worker_];
+	next_worker_ = (next_worker_ + 1) % workers_.size();
+	return worker;
+}
+
+void Server::Shutdown()
+{
+	if (!state_.Stop())
+	{
+		return;
+	}
+
+	boost::system::error_code ec;
+	acceptor_.close(ec);
+	accept_timer_.cancel();
+	signals_.cancel(ec);
+	handoff_acceptor_.close(ec);
+	if (handoff_channel_)
+	{
+		handoff_channel_->close(ec);
+	}
+	DrainConnections();
+}
+
+void Server::StartHandoff()
+{
+	handoff_channel_.emplace(io_context_);
+	handoff_acceptor_.async_accept(
+		*handoff_channel_,
+		[this](const boost::system::error_code& ec)
+		{
+			if (ec)
+			{
+				if (ec != boost::asio::error::operation_aborted)
+				{
+					std::cerr << "Handoff socket error: " << ec.message() << std::endl;
+					StartHandoff();
+				}
+				return;
+			}
+
+			if (!SendListener(handoff_channel_->native_handle(), acceptor_.native_handle()))
+			{
+				std::cerr << "Can't pass listener to new server" << std::endl;
+				StartHandoff();
+				return;
+			}
+
+			// Server keeps accepting until new server confirms that it uses listener.
+			boost::asio::async_read(
+				*handoff_channel_,
+				boost::asio::buffer(&handoff_confirmation_, sizeof(handoff_confirmation_)),
+				[this](const boost::system::error_code& read_ec, size_t)
+				{
+					if (read_ec == boost::asio::error::operation_aborted)
+					{
+						return;
+					}
+					if (read_ec || handoff_confirmation_ != listener_confirmation)
+					{
+						std::cerr << "New server didn't confirm listener" << std::endl;
+						StartHandoff();
+						return;
+					}
+
+					std::cout << "Listener is handed off to new server" << std::endl;
+					Shutdown();
+				});
+		});
+}
+
+void Server::DrainConnections()
+{
+	for (auto& worker : workers_)
+	{
+		// Connections list belongs to io thread, connections passed to it before are already started.
+		boost::asio::post(
+			worker->io_context,
+			[&worker = *worker]()
+			{
+				for (const auto& started_connection : worker.started_connections)
+				{
+					if (auto connection = started_connection.lock())
+					{
+						connection->Drain();
+					}
+				}
+				worker.started_connections.clear();
+			});
+		worker->work.reset();
+	}
 }
 
 } // namespace Http::Server
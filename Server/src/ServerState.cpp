@@ -1,17 +1,219 @@
 #include <CustomServer/ServerState.hpp>
 
+#include <Http/HttpResponse.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
 
 namespace Http::Server
 {
 
+namespace
+{
+
+SharedBuffer MakeOverloadResponse(const AdmissionOptions& admission_options)
+{
+	auto response = StockResponse(StatusCode::ServiceUnavailable);
+	response.SetHeader("Retry-After", std::to_string(admission_options.retry_after.count()));
+	return std::make_shared<const std::string>(
+		response.PackHeadersToString("Connection: close\r\n") + response.GetBody());
+}
+
+//! Shard of next thread, which isn't bound explicitly.
+std::atomic_size_t next_thread_shard = 0;
+//! Shard of thread.
+thread_local size_t thread_shard = next_thread_shard++;
+
+} // namespace
+
+State::State(const AdmissionOptions& admission_options, const size_t shards_count)
+	: admission_options_(admission_options)
+	, overload_response_(MakeOverloadResponse(admission_options_))
+	, concurrency_limiter_(admission_options_.adaptive_concurrency
+		? std::make_unique<ConcurrencyLimiter>(*admission_options_.adaptive_concurrency)
+		: nullptr)
+	, shards_(std::max<size_t>(shards_count, 1))
+	, metrics_(shards_.size())
+{
+}
+
+void State::BindCurrentThread(const size_t shard) noexcept
+{
+	thread_shard = shard;
+}
+
+size_t State::GetCurrentThreadShard() noexcept
+{
+	return thread_shard;
+}
+
 void State::AddConnection() noexcept
 {
-	++connection_count_;
+	++GetShard().connections;
 }
 
 void State::RemoveConnection() noexcept
 {
-	--connection_count_;
+	// Decrements are sequentially consistent, so thread removing last connection sees zero sum.
+	--GetShard().connections;
+	// Waiter checks count under mutex, so notification isn't lost.
+	if (stopped_ && ConnectionCount() == 0)
+	{
+		std::lock_guard lock{connections_mutex_};
+		connections_closed_.notify_all();
+	}
+}
+
+bool State::CanAcceptConnection() const noexcept
+{
+	return admission_options_.max_connections == 0 || ConnectionCount() < admission_options_.max_connections;
+}
+
+bool State::TryAddRequest() noexcept
+{
+	auto& shard = GetShard();
+	if ((admission_options_.max_buffered_bytes != 0
+			&& Sum(&Shard::buffered_bytes) >= admission_options_.max_buffered_bytes)
+		|| (admission_options_.max_requests_in_flight != 0
+			&& Sum(&Shard::requests_in_flight) >= admission_options_.max_requests_in_flight))
+	{
+		shard.rejected_requests.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	shard.requests_in_flight.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void State::AddRequest() noexcept
+{
+	GetShard().requests_in_flight.fetch_add(1, std::memory_order_relaxed);
+}
+
+void State::RemoveRequest() noexcept
+{
+	auto& shard = GetShard();
+	shard.requests_in_flight.fetch_sub(1, std::memory_order_relaxed);
+	shard.requests.fetch_add(1, std::memory_order_relaxed);
+}
+
+unsigned State::RequestsInFlight() const noexcept
+{
+	return static_cast<unsigned>(Sum(&Shard::requests_in_flight));
+}
+
+void State::AddBufferedBytes(const size_t bytes) noexcept
+{
+	GetShard().buffered_bytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+}
+
+void State::RemoveBufferedBytes(const size_t bytes) noexcept
+{
+	GetShard().buffered_bytes.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+}
+
+const SharedBuffer& State::GetOverloadResponse() const noexcept
+{
+	return overload_response_;
+}
+
+const AdmissionOptions& State::GetAdmissionOptions() const noexcept
+{
+	return admission_options_;
+}
+
+uint64_t State::RejectedRequestsCount() const noexcept
+{
+	return Sum(&Shard::rejected_requests);
+}
+
+void State::AddBytesReceived(const size_t bytes) noexcept
+{
+	GetShard().bytes_received.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void State::AddBytesSent(const size_t bytes) noexcept
+{
+	GetShard().bytes_sent.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void State::AddError(const ConnectionError error) noexcept
+{
+	auto& shard = GetShard();
+	switch (error)
+	{
+	case ConnectionError::Read:
+		shard.read_errors.fetch_add(1, std::memory_order_relaxed);
+		break;
+	case ConnectionError::Write:
+		shard.write_errors.fetch_add(1, std::memory_order_relaxed);
+		break;
+	case ConnectionError::BadRequest:
+		shard.bad_requests.fetch_add(1, std::memory_order_relaxed);
+		break;
+	case ConnectionError::Timeout:
+		shard.timeouts.fetch_add(1, std::memory_order_relaxed);
+		break;
+	}
+}
+
+Metrics& State::GetMetrics() noexcept
+{
+	return metrics_;
+}
+
+const Metrics& State::GetMetrics() const noexcept
+{
+	return metrics_;
+}
+
+ServerCounters State::GetCounters() const noexcept
+{
+	ServerCounters counters;
+	counters.connections = Sum(&Shard::connections);
+	counters.requests_in_flight = Sum(&Shard::requests_in_flight);
+	counters.requests = Sum(&Shard::requests);
+	counters.rejected_requests = Sum(&Shard::rejected_requests);
+	counters.buffered_bytes = Sum(&Shard::buffered_bytes);
+	counters.bytes_received = Sum(&Shard::bytes_received);
+	counters.bytes_sent = Sum(&Shard::bytes_sent);
+	counters.read_errors = Sum(&Shard::read_errors);
+	counters.write_errors = Sum(&Shard::write_errors);
+	counters.bad_requests = Sum(&Shard::bad_requests);
+	counters.timeouts = Sum(&Shard::timeouts);
+	return counters;
+}
+
+void State::AddAcceptBatch(const size_t accepted) noexcept
+{
+	accepted_connections_ += accepted;
+	++accept_batches_;
+}
+
+void State::AddAcceptError() noexcept
+{
+	++accept_errors_;
+}
+
+void State::AddAcceptPause() noexcept
+{
+	++accept_pauses_;
+}
+
+AcceptStats State::GetAcceptStats() const noexcept
+{
+	AcceptStats stats;
+	stats.accepted = accepted_connections_;
+	stats.batches = accept_batches_;
+	stats.errors = accept_errors_;
+	stats.pauses = accept_pauses_;
+	return stats;
+}
+
+ConcurrencyLimiter* State::GetConcurrencyLimiter() noexcept
+{
+	return concurrency_limiter_.get();
 }
 
 bool State::Stop() noexcept
@@ -22,12 +224,19 @@ bool State::Stop() noexcept
 
 unsigned State::ConnectionCount() const noexcept
 {
-	return connection_count_;
+	return static_cast<unsigned>(Sum(&Shard::connections));
 }
 
-bool State::HasConnections() const noexcept
+bool State::WaitConnectionsClosed(const std::chrono::steady_clock::time_point deadline)
 {
-	return !stopped_ || connection_count_ != 0;
+	std::unique_lock lock{connections_mutex_};
+	return connections_closed_.wait_until(
+		lock,
+		deadline,
+		[this]()
+		{
+			return ConnectionCount() == 0;
+		});
 }
 
 bool State::IsStopped() const noexcept
@@ -35,5 +244,31 @@ bool State::IsStopped() const noexcept
 	return stopped_;
 }
 
+State::Shard& State::GetShard() noexcept
+{
+	return shards_[thread_shard % shards_.size()];
+}
+
+uint64_t State::Sum(std::atomic_int64_t Shard::*gauge) const noexcept
+{
+	int64_t sum = 0;
+	for (const auto& shard : shards_)
+	{
+		sum += (shard.*gauge).load();
+	}
+	// Shards are read one by one, so sum of concurrent updates may be negative for a moment.
+	return sum > 0 ? static_cast<uint64_t>(sum) : 0;
+}
+
+uint64_t State::Sum(std::atomic_uint64_t Shard::*counter) const noexcept
+{
+	uint64_t sum = 0;
+	for (const auto& shard : shards_)
+	{
+		sum += (shard.*counter).load(std::memory_order_relaxed);
+	}
+	return sum;
+}
+
 
 } // namespace Http::Server
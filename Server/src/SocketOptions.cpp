@@ -0,0 +1,176 @@
+#include <CustomServer/SocketOptions.hpp>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+
+namespace Http::Server
+{
+
+namespace
+{
+
+boost::system::error_code SetOption(const int fd, const int level, const int name, const int value) noexcept
+{
+	if (::setsockopt(fd, level, name, &value, sizeof(value)) != 0)
+	{
+		return boost::system::error_code{errno, boost::system::system_category()};
+	}
+	return {};
+}
+
+void ThrowOnError(const boost::system::error_code& ec, const char* option)
+{
+	if (ec)
+	{
+		throw boost::system::system_error(ec, option);
+	}
+}
+
+} // namespace
+
+void OpenAcceptor(
+	boost::asio::ip::tcp::acceptor& acceptor,
+	const boost::asio::ip::tcp::endpoint& endpoint,
+	const ListenerOptions& options)
+{
+	acceptor.open(endpoint.protocol());
+	const auto fd = acceptor.native_handle();
+	acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(options.reuse_address));
+	if (options.reuse_port)
+	{
+		ThrowOnError(SetOption(fd, SOL_SOCKET, SO_REUSEPORT, 1), "SO_REUSEPORT");
+	}
+	// Buffer sizes are inherited by accepted sockets.
+	if (options.receive_buffer_size)
+	{
+		ThrowOnError(SetOption(fd, SOL_SOCKET, SO_RCVBUF, *options.receive_buffer_size), "SO_RCVBUF");
+	}
+	if (options.send_buffer_size)
+	{
+		ThrowOnError(SetOption(fd, SOL_SOCKET, SO_SNDBUF, *options.send_buffer_size), "SO_SNDBUF");
+	}
+	if (options.defer_accept)
+	{
+		ThrowOnError(
+			SetOption(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, static_cast<int>(options.defer_accept->count())),
+			"TCP_DEFER_ACCEPT");
+	}
+	if (options.fast_open_queue)
+	{
+		ThrowOnError(SetOption(fd, IPPROTO_TCP, TCP_FASTOPEN, *options.fast_open_queue), "TCP_FASTOPEN");
+	}
+	acceptor.bind(endpoint);
+	acceptor.listen(options.backlog);
+}
+
+int CreateListener(const boost::asio::ip::tcp::endpoint& endpoint, const ListenerOptions& options)
+{
+	boost::asio::io_context io_context;
+	boost::asio::ip::tcp::acceptor acceptor(io_context);
+	OpenAcceptor(acceptor, endpoint, options);
+	return acceptor.release();
+}
+
+void AssignAcceptor(boost::asio::ip::tcp::acceptor& acceptor, const int fd, const ListenerOptions& options)
+{
+	sockaddr_storage address{};
+	socklen_t size = sizeof(address);
+	if (::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &size) != 0)
+	{
+		throw boost::system::system_error(
+			boost::system::error_code{errno, boost::system::system_category()},
+			"Can't get address of listener");
+	}
+	acceptor.assign(address.ss_family == AF_INET6 ? boost::asio::ip::tcp::v6() : boost::asio::ip::tcp::v4(), fd);
+	acceptor.listen(options.backlog);
+}
+
+boost::system::error_code ApplyAcceptedSocketOptions(
+	boost::asio::ip::tcp::socket& socket,
+	const ListenerOptions& options) noexcept
+{
+	const auto fd = socket.native_handle();
+	boost::system::error_code result;
+	const auto set_option = [fd, &result](const int level, const int name, const int value)
+	{
+		const auto ec = SetOption(fd, level, name, value);
+		if (ec && !result)
+		{
+			result = ec;
+		}
+	};
+
+	if (options.no_delay)
+	{
+		set_option(IPPROTO_TCP, TCP_NODELAY, 1);
+	}
+	if (options.quick_ack)
+	{
+		set_option(IPPROTO_TCP, TCP_QUICKACK, 1);
+	}
+	if (options.busy_poll)
+	{
+		set_option(SOL_SOCKET, SO_BUSY_POLL, *options.busy_poll);
+	}
+	if (options.keep_alive)
+	{
+		set_option(SOL_SOCKET, SO_KEEPALIVE, 1);
+		set_option(IPPROTO_TCP, TCP_KEEPIDLE, static_cast<int>(options.keep_alive->idle.count()));
+		set_option(IPPROTO_TCP, TCP_KEEPINTVL, static_cast<int>(options.keep_alive->interval.count()));
+		set_option(IPPROTO_TCP, TCP_KEEPCNT, options.keep_alive->count);
+	}
+	return result;
+}
+
+boost::system::error_code RenewQuickAck(boost::asio::ip::tcp::socket& socket) noexcept
+{
+	return SetOption(socket.native_handle(), IPPROTO_TCP, TCP_QUICKACK, 1);
+}
+
+uint64_t GetAcceptQueueLength(boost::asio::ip::tcp::acceptor& acceptor) noexcept
+{
+	// For listening socket unacked field is accept queue length.
+	tcp_info info{};
+	socklen_t size = sizeof(info);
+	if (::getsockopt(acceptor.native_handle(), IPPROTO_TCP, TCP_INFO, &info, &size) != 0)
+	{
+		return 0;
+	}
+	return info.tcpi_unacked;
+}
+
+uint64_t GetListenOverflows()
+{
+	// TcpExt section is pair of lines: field names and values.
+	std::ifstream netstat("/proc/net/netstat");
+	std::string names;
+	std::string values;
+	while (std::getline(netstat, names) && std::getline(netstat, values))
+	{
+		if (names.rfind("TcpExt:", 0) != 0)
+		{
+			continue;
+		}
+		std::istringstream names_stream(names);
+		std::istringstream values_stream(values);
+		std::string name;
+		std::string value;
+		while (names_stream >> name && values_stream >> value)
+		{
+			if (name == "ListenOverflows")
+			{
+				return std::stoull(value);
+			}
+		}
+	}
+	return 0;
+}
+
+} // namespace Http::Server
@@ -0,0 +1,376 @@
+#include <CustomServer/Tracing.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+
+namespace Http::Server
+{
+
+namespace
+{
+
+//! Names of phases in exported span.
+constexpr const char* phase_names[request_phases_count] = {
+	"first_byte",
+	"headers_parsed",
+	"body_complete",
+	"handler_dispatched",
+	"handler_responded",
+	"first_byte_written",
+	"last_byte_written",
+};
+
+//! Length of traceparent of version 00: "00-" trace id "-" span id "-" flags.
+constexpr size_t traceparent_size = 55;
+
+constexpr char hex_digits[] = "0123456789abcdef";
+
+/**
+ * \brief Return random generator of calling thread.
+ */
+std::mt19937_64& GetRandom()
+{
+	thread_local std::mt19937_64 random{std::random_device{}()};
+	return random;
+}
+
+template <size_t N>
+bool IsZero(const std::array<uint8_t, N>& id) noexcept
+{
+	return std::all_of(id.begin(), id.end(), [](const uint8_t byte) { return byte == 0; });
+}
+
+/**
+ * \brief Fill id with random bytes, id isn't zero.
+ */
+template <size_t N>
+void GenerateId(std::array<uint8_t, N>& id)
+{
+	auto& random = GetRandom();
+	do
+	{
+		for (size_t i = 0; i < N; i += 8)
+		{
+			const auto value = random();
+			std::memcpy(id.data() + i, &value, std::min<size_t>(8, N - i));
+		}
+	}
+	while (IsZero(id));
+}
+
+/**
+ * \brief Parse lowercase hex into bytes, false if it is invalid.
+ */
+template <size_t N>
+bool ParseHex(const std::string_view hex, std::array<uint8_t, N>& bytes) noexcept
+{
+	if (hex.size() != 2 * N)
+	{
+		return false;
+	}
+	const auto digit = [](const char ch) -> int
+	{
+		const auto* position = std::strchr(hex_digits, ch);
+		return ch != '\0' && position ? static_cast<int>(position - hex_digits) : -1;
+	};
+	for (size_t i = 0; i < N; ++i)
+	{
+		const auto high = digit(hex[2 * i]);
+		const auto low = digit(hex[2 * i + 1]);
+		if (high < 0 || low < 0)
+		{
+			return false;
+		}
+		bytes[i] = static_cast<uint8_t>(high << 4 | low);
+	}
+	return true;
+}
+
+template <size_t N>
+void AppendId(std::string& out, const std::array<uint8_t, N>& id)
+{
+	for (const auto byte : id)
+	{
+		out += hex_digits[byte >> 4];
+		out += hex_digits[byte & 0xf];
+	}
+}
+
+void AppendJsonString(std::string& out, const std::string_view value)
+{
+	out += '"';
+	for (const auto ch : value)
+	{
+		if (ch == '"' || ch == '\\')
+		{
+			out += '\\';
+			out += ch;
+		}
+		else if (static_cast<unsigned char>(ch) < 0x20)
+		{
+			char escaped[7];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(ch));
+			out += escaped;
+		}
+		else
+		{
+			out += ch;
+		}
+	}
+	out += '"';
+}
+
+} // namespace
+
+RequestTimeline::Clock::time_point RequestTimeline::Mark(const RequestPhase phase) noexcept
+{
+	const auto now = Clock::now();
+	Mark(phase, now);
+	return now;
+}
+
+void RequestTimeline::Mark(const RequestPhase phase, const Clock::time_point time) noexcept
+{
+	phases_[static_cast<size_t>(phase)] = time;
+}
+
+bool RequestTimeline::Has(const RequestPhase phase) const noexcept
+{
+	return Get(phase) != Clock::time_point{};
+}
+
+RequestTimeline::Clock::time_point RequestTimeline::Get(const RequestPhase phase) const noexcept
+{
+	return phases_[static_cast<size_t>(phase)];
+}
+
+std::optional<RequestTimeline::Clock::duration> RequestTimeline::GetDuration(
+	const RequestPhase from,
+	const RequestPhase to) const noexcept
+{
+	if (!Has(from) || !Has(to))
+	{
+		return std::nullopt;
+	}
+	return Get(to) - Get(from);
+}
+
+void RequestTimeline::Reset() noexcept
+{
+	phases_.fill(Clock::time_point{});
+}
+
+std::optional<TraceContext> ParseTraceParent(const std::string_view value) noexcept
+{
+	if (value.size() < traceparent_size || value[2] != '-' || value[35] != '-' || value[52] != '-')
+	{
+		return std::nullopt;
+	}
+	std::array<uint8_t, 1> version{};
+	std::array<uint8_t, 1> flags{};
+	TraceContext context;
+	if (!ParseHex(value.substr(0, 2), version)
+		|| !ParseHex(value.substr(3, 32), context.trace_id)
+		|| !ParseHex(value.substr(36, 16), context.span_id)
+		|| !ParseHex(value.substr(53, 2), flags)
+		|| IsZero(context.trace_id)
+		|| IsZero(context.span_id))
+	{
+		return std::nullopt;
+	}
+	// Later versions may append fields after known ones, version ff is invalid.
+	if (version[0] == 0xff
+		|| (version[0] == 0 && value.size() != traceparent_size)
+		|| (value.size() > traceparent_size && value[traceparent_size] != '-'))
+	{
+		return std::nullopt;
+	}
+	context.sampled = (flags[0] & 0x01) != 0;
+	return context;
+}
+
+std::string FormatTraceParent(const TraceContext& context)
+{
+	std::string value;
+	value.reserve(traceparent_size);
+	value += "00-";
+	AppendId(value, context.trace_id);
+	value += '-';
+	AppendId(value, context.span_id);
+	value += context.sampled ? "-01" : "-00";
+	return value;
+}
+
+Tracer::Tracer(const TracerOptions& options)
+	: options_(options)
+	, steady_anchor_(RequestTimeline::Clock::now())
+	, system_anchor_(std::chrono::system_clock::now())
+{
+	// Lines are appended by one write, so worker processes can share file.
+	output_ = ::open(options_.output_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (output_ < 0)
+	{
+		throw std::runtime_error("Can't open trace file " + options_.output_path + ": " + std::strerror(errno));
+	}
+
+	thread_ = std::thread{
+		[this]()
+		{
+			std::unique_lock lock{mutex_};
+			while (true)
+			{
+				condition_.wait(lock, [this]() { return stopped_ || !queue_.empty(); });
+				if (queue_.empty())
+				{
+					return;
+				}
+				auto spans = std::move(queue_);
+				queue_.clear();
+				lock.unlock();
+				for (const auto& span : spans)
+				{
+					if (WriteSpan(span))
+					{
+						++exported_;
+					}
+					else
+					{
+						++dropped_;
+					}
+				}
+				lock.lock();
+			}
+		}};
+}
+
+Tracer::~Tracer()
+{
+	Stop();
+	::close(output_);
+}
+
+void Tracer::Stop()
+{
+	{
+		std::lock_guard lock{mutex_};
+		stopped_ = true;
+	}
+	condition_.notify_all();
+	if (thread_.joinable())
+	{
+		thread_.join();
+	}
+}
+
+TraceContext Tracer::StartSpan(const std::optional<TraceContext>& parent)
+{
+	TraceContext context;
+	if (parent)
+	{
+		context.trace_id = parent->trace_id;
+		context.sampled = parent->sampled;
+	}
+	else
+	{
+		GenerateId(context.trace_id);
+		context.sampled = std::generate_canonical<double, 53>(GetRandom()) < options_.sample_rate;
+	}
+	GenerateId(context.span_id);
+	return context;
+}
+
+void Tracer::Export(Span span)
+{
+	{
+		std::lock_guard lock{mutex_};
+		if (stopped_ || queue_.size() >= options_.max_queue_size)
+		{
+			++dropped_;
+			return;
+		}
+		queue_.push_back(std::move(span));
+	}
+	condition_.notify_one();
+}
+
+uint64_t Tracer::ExportedCount() const noexcept
+{
+	return exported_;
+}
+
+uint64_t Tracer::DroppedCount() const noexcept
+{
+	return dropped_;
+}
+
+bool Tracer::WriteSpan(const Span& span) noexcept
+{
+	const auto& timeline = span.timeline;
+	const auto start = timeline.Get(RequestPhase::FirstByte);
+	const auto to_unix_nanoseconds = [this](const RequestTimeline::Clock::time_point time)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			(system_anchor_ + std::chrono::duration_cast<std::chrono::system_clock::duration>(time - steady_anchor_))
+				.time_since_epoch()).count();
+	};
+
+	try
+	{
+		std::string line = "{\"trace_id\":\"";
+		AppendId(line, span.context.trace_id);
+		line += "\",\"span_id\":\"";
+		AppendId(line, span.context.span_id);
+		line += '"';
+		if (span.parent_span_id)
+		{
+			line += ",\"parent_span_id\":\"";
+			AppendId(line, *span.parent_span_id);
+			line += '"';
+		}
+		line += ",\"name\":";
+		AppendJsonString(line, span.name);
+		line += ",\"start_unix_nano\":" + std::to_string(to_unix_nanoseconds(start));
+		line += ",\"end_unix_nano\":" + std::to_string(to_unix_nanoseconds(timeline.Get(RequestPhase::LastByteWritten)));
+		line += ",\"status_code\":" + std::to_string(span.status_code);
+		line += ",\"connection_id\":" + std::to_string(span.connection_id);
+		// Phases are nanoseconds since first byte of request, phases which weren't reached are skipped.
+		line += ",\"phases\":{";
+		auto first = true;
+		for (size_t phase = 0; phase < request_phases_count; ++phase)
+		{
+			if (!timeline.Has(static_cast<RequestPhase>(phase)))
+			{
+				continue;
+			}
+			line += first ? "\"" : ",\"";
+			line += phase_names[phase];
+			line += "\":";
+			line += std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				timeline.Get(static_cast<RequestPhase>(phase)) - start).count());
+			first = false;
+		}
+		line += "}}\n";
+
+		ssize_t written = 0;
+		do
+		{
+			written = ::write(output_, line.data(), line.size());
+		}
+		while (written < 0 && errno == EINTR);
+		return written == static_cast<ssize_t>(line.size());
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+}
+
+} // namespace Http::Server
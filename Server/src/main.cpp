@@ -1,44 +1,513 @@
+#include <CustomServer/AsyncFileReader.hpp>
+#include <CustomServer/BlockingTaskPool.hpp>
+#include <CustomServer/CpuAffinity.hpp>
+#include <CustomServer/Metrics.hpp>
+#include <CustomServer/Pipeline.hpp>
+#include <CustomServer/Prefork.hpp>
 #include <CustomServer/Server.hpp>
+#include <CustomServer/Tracing.hpp>
 #include <CustomServer/RequestHandler.hpp>
+#include <CustomServer/ResponseCompressor.hpp>
+#include <CustomServer/Router.hpp>
 
 #include <Http/HttpRequest.hpp>
 #include <Http/HttpResponse.hpp>
 
+#include <boost/program_options.hpp>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include <iostream>
 #include <memory>
 #include <exception>
+#include <optional>
+#include <sstream>
+#include <string>
+
+
+namespace
+{
+
+using HttpRequestConnectionPtr = std::shared_ptr<Http::Server::HttpRequestConnection>;
+
+// File isn't read, if client copy is valid or compressed body is cached.
+Http::HttpResponse HandleFileRequest(
+	const Http::HttpRequest& request,
+	Http::Server::RequestHandler& request_handler,
+	Http::Server::ResponseCompressor& response_compressor)
+{
+	auto prepared = request_handler.PrepareResponse(request);
+	if (!prepared.file_path)
+	{
+		response_compressor.Compress(request, prepared.response);
+		return std::move(prepared.response);
+	}
+
+	const auto fd = request_handler.OpenResponseFile(prepared);
+	if (fd < 0)
+	{
+		return Http::StockResponse(Http::StatusCode::NotFound);
+	}
+	const auto compression = response_compressor.PrepareCompression(request, prepared.response, prepared.file_size);
+	if (compression == Http::Server::PendingCompression::Done)
+	{
+		::close(fd);
+		return std::move(prepared.response);
+	}
+	if (compression == Http::Server::PendingCompression::None)
+	{
+		// File is sent by sendfile from network thread, readahead is started here to avoid blocking it.
+		::posix_fadvise(fd, 0, static_cast<off_t>(prepared.file_size), POSIX_FADV_WILLNEED);
+		prepared.response.SetFileBody(Http::FileRegion{std::make_shared<Http::FileDescriptor>(fd), 0, prepared.file_size});
+		return std::move(prepared.response);
+	}
+
+	auto content = Http::Server::RequestHandler::ReadFile(fd, prepared.file_size);
+	if (!content)
+	{
+		return Http::StockResponse(Http::StatusCode::NotFound);
+	}
+	response_compressor.CompressPrepared(request, prepared.response, std::move(*content));
+	return std::move(prepared.response);
+}
+
+// File system calls may block, so request is handled out of network threads.
+void HandleInBlockingPool(
+	HttpRequestConnectionPtr http_request,
+	Http::Server::RequestHandler& request_handler,
+	Http::Server::ResponseCompressor& response_compressor,
+	Http::Server::BlockingTaskPool& blocking_task_pool)
+{
+	const auto posted = blocking_task_pool.Post(
+		[http_request, &request_handler, &response_compressor]()
+		{
+			const auto& request = http_request->GetRequest();
+			std::shared_ptr<Http::HttpResponse> response;
+			try
+			{
+				response = std::make_shared<Http::HttpResponse>(
+					HandleFileRequest(request, request_handler, response_compressor));
+			}
+			catch (const std::exception& exc)
+			{
+				// Error response is sent from connection context like any other response.
+				std::cerr << "Request handling failed: " << exc.what() << std::endl;
+				response = std::make_shared<Http::HttpResponse>(Http::StockResponse(Http::StatusCode::InternalServerError));
+			}
+			http_request->Post(
+				[http_request, response]()
+				{
+					http_request->Send(*response);
+				});
+		});
+	if (!posted)
+	{
+		http_request->Send(Http::StockResponse(Http::StatusCode::ServiceUnavailable));
+	}
+}
+
+// Response is sent from connection context, it may be ready in any thread.
+void PostResponse(const HttpRequestConnectionPtr& http_request, Http::HttpResponse response)
+{
+	http_request->Post(
+		[http_request, response = std::move(response)]()
+		{
+			http_request->Send(response);
+		});
+}
+
+// File content is read via io_uring (sendfile could block calling thread on disk).
+void ReadPreparedResponse(
+	HttpRequestConnectionPtr http_request,
+	Http::Server::PreparedResponse prepared,
+	Http::Server::RequestHandler& request_handler,
+	Http::Server::ResponseCompressor& response_compressor,
+	Http::Server::AsyncFileReader& async_file_reader)
+{
+	const auto& request = http_request->GetRequest();
+	if (!prepared.file_path)
+	{
+		response_compressor.Compress(request, prepared.response);
+		PostResponse(http_request, std::move(prepared.response));
+		return;
+	}
+
+	// Open is done via doc root descriptor, so file can't be outside of doc root.
+	const auto fd = request_handler.OpenResponseFile(prepared);
+	if (fd < 0)
+	{
+		PostResponse(http_request, Http::StockResponse(Http::StatusCode::NotFound));
+		return;
+	}
+	const auto compression = response_compressor.PrepareCompression(request, prepared.response, prepared.file_size);
+	if (compression == Http::Server::PendingCompression::Done)
+	{
+		::close(fd);
+		PostResponse(http_request, std::move(prepared.response));
+		return;
+	}
+
+	auto response = std::make_shared<Http::HttpResponse>(std::move(prepared.response));
+	async_file_reader.AsyncReadFile(
+		fd,
+		prepared.file_size,
+		[http_request, response, &response_compressor, compression](const boost::system::error_code& ec, std::string content)
+		{
+			http_request->Post(
+				[http_request, response, &response_compressor, compression, ec, content = std::move(content)]() mutable
+				{
+					if (ec)
+					{
+						http_request->Send(Http::StockResponse(Http::StatusCode::NotFound));
+						return;
+					}
+					if (compression == Http::Server::PendingCompression::NeedsBody)
+					{
+						response_compressor.CompressPrepared(http_request->GetRequest(), *response, std::move(content));
+					}
+					else
+					{
+						response->SetBody(std::move(content));
+					}
+					http_request->Send(*response);
+				});
+		});
+}
+
+// Response of file with cached metadata is prepared on network thread (only open is done there),
+// metadata cache misses (stat) and directory listing are done by blocking pool.
+void HandleWithAsyncFileReader(
+	HttpRequestConnectionPtr http_request,
+	Http::Server::RequestHandler& request_handler,
+	Http::Server::ResponseCompressor& response_compressor,
+	Http::Server::BlockingTaskPool& blocking_task_pool,
+	Http::Server::AsyncFileReader& async_file_reader)
+{
+	if (auto prepared = request_handler.TryPrepareResponse(http_request->GetRequest()))
+	{
+		ReadPreparedResponse(
+			std::move(http_request), std::move(*prepared), request_handler, response_compressor, async_file_reader);
+		return;
+	}
+
+	const auto posted = blocking_task_pool.Post(
+		[http_request, &request_handler, &response_compressor, &async_file_reader]()
+		{
+			try
+			{
+				auto prepared = request_handler.PrepareResponse(http_request->GetRequest());
+				ReadPreparedResponse(http_request, std::move(prepared), request_handler, response_compressor, async_file_reader);
+			}
+			catch (const std::exception& exc)
+			{
+				std::cerr << "Request handling failed: " << exc.what() << std::endl;
+				PostResponse(http_request, Http::StockResponse(Http::StatusCode::InternalServerError));
+			}
+		});
+	if (!posted)
+	{
+		http_request->Send(Http::StockResponse(Http::StatusCode::ServiceUnavailable));
+	}
+}
+
+// Keepalive probes are set as "idle,interval,count".
+Http::Server::TcpKeepAlive ParseTcpKeepAlive(const std::string& value)
+{
+	Http::Server::TcpKeepAlive keep_alive;
+	unsigned idle = 0;
+	unsigned interval = 0;
+	char separator1 = 0;
+	char separator2 = 0;
+	std::istringstream stream(value);
+	if (!(stream >> idle >> separator1 >> interval >> separator2 >> keep_alive.count)
+		|| separator1 != ',' || separator2 != ',' || !stream.eof())
+	{
+		throw std::runtime_error("Incorrect tcp keepalive " + value);
+	}
+	keep_alive.idle = std::chrono::seconds{idle};
+	keep_alive.interval = std::chrono::seconds{interval};
+	return keep_alive;
+}
+
+Http::Server::ListenerOptions MakeListenerOptions(const boost::program_options::variables_map& options)
+{
+	Http::Server::ListenerOptions listener_options;
+	listener_options.backlog = options["backlog"].as<int>();
+	listener_options.max_accept_batch = options["accept-batch"].as<size_t>();
+	const auto& balancing = options["accept-balancing"].as<std::string>();
+	if (balancing == "least-loaded")
+	{
+		listener_options.balancing = Http::Server::AcceptBalancing::LeastLoaded;
+	}
+	else if (balancing == "incoming-cpu")
+	{
+		listener_options.balancing = Http::Server::AcceptBalancing::IncomingCpu;
+	}
+	else if (balancing != "round-robin")
+	{
+		throw std::runtime_error("Unknown accept balancing " + balancing);
+	}
+	listener_options.no_delay = options["tcp-nodelay"].as<bool>();
+	listener_options.quick_ack = options.count("quick-ack") != 0;
+	if (options.count("defer-accept"))
+	{
+		listener_options.defer_accept = std::chrono::seconds{options["defer-accept"].as<unsigned>()};
+	}
+	if (options.count("fast-open"))
+	{
+		listener_options.fast_open_queue = options["fast-open"].as<int>();
+	}
+	if (options.count("rcvbuf"))
+	{
+		listener_options.receive_buffer_size = options["rcvbuf"].as<int>();
+	}
+	if (options.count("sndbuf"))
+	{
+		listener_options.send_buffer_size = options["sndbuf"].as<int>();
+	}
+	if (options.count("busy-poll"))
+	{
+		listener_options.busy_poll = options["busy-poll"].as<int>();
+	}
+	if (options.count("tcp-keepalive"))
+	{
+		listener_options.keep_alive = ParseTcpKeepAlive(options["tcp-keepalive"].as<std::string>());
+	}
+	if (options.count("handoff-socket"))
+	{
+		listener_options.handoff_path = options["handoff-socket"].as<std::string>();
+	}
+	return listener_options;
+}
 
+// Handlers, thread pools and server are created by every worker process.
+int RunServer(
+	const boost::program_options::variables_map& options,
+	const Http::Server::ListenerOptions& listener_options,
+	Http::Server::WorkerCounters* worker_counters,
+	const std::chrono::milliseconds publish_interval)
+{
+	Http::Server::RequestHandler request_handler(options["doc_root"].as<std::string>());
+	Http::Server::ResponseCompressor response_compressor;
+	Http::Server::BlockingTaskPool blocking_task_pool(
+		options["io-threads"].as<size_t>(),
+		options["io-queue-size"].as<size_t>());
+
+	std::optional<Http::Server::AsyncFileReader> async_file_reader;
+	const auto& file_io = options["file-io"].as<std::string>();
+	if (file_io == "uring")
+	{
+		async_file_reader.emplace();
+	}
+	else if (file_io != "pool")
+	{
+		throw std::runtime_error("Unknown file io mode " + file_io);
+	}
+
+	// Every file is served by one route, other methods are answered with 405 by router.
+	const auto serve_file =
+		[&request_handler, &response_compressor, &blocking_task_pool, &async_file_reader]
+		(Http::Server::HttpRequestConnectionUPtr http_request, const Http::Server::RouteParameters&)
+		{
+			if (async_file_reader)
+			{
+				HandleWithAsyncFileReader(
+					std::move(http_request), request_handler, response_compressor, blocking_task_pool, *async_file_reader);
+				return;
+			}
+			HandleInBlockingPool(std::move(http_request), request_handler, response_compressor, blocking_task_pool);
+		};
+	Http::Server::RouterBuilder router_builder;
+	for (const auto method : {Http::HttpMethodType::Get, Http::HttpMethodType::Head})
+	{
+		router_builder.Add(method, "/", serve_file).Add(method, "/*path", serve_file);
+	}
+	auto pipeline = Http::Server::MakePipeline(router_builder.Build());
+
+	Http::Server::ConnectionOptions connection_options;
+	connection_options.timeout = std::chrono::seconds{options["keep-alive-timeout"].as<unsigned>()};
+	connection_options.max_requests = options["max-requests"].as<size_t>();
+	connection_options.drain_timeout = std::chrono::seconds{options["drain-timeout"].as<unsigned>()};
+	if (options.count("metrics-path"))
+	{
+		connection_options.metrics_path = options["metrics-path"].as<std::string>();
+	}
+	// Tracer outlives server, spans of drained connections are exported.
+	std::optional<Http::Server::Tracer> tracer;
+	if (options.count("trace-file"))
+	{
+		Http::Server::TracerOptions tracer_options;
+		tracer_options.output_path = options["trace-file"].as<std::string>();
+		tracer_options.sample_rate = options["trace-sample-rate"].as<double>();
+		connection_options.tracer = &tracer.emplace(tracer_options);
+	}
+
+	Http::Server::AdmissionOptions admission_options;
+	admission_options.max_connections = options["max-connections"].as<unsigned>();
+	admission_options.max_requests_in_flight = options["max-requests-in-flight"].as<unsigned>();
+	admission_options.max_buffered_bytes = options["max-buffered-bytes"].as<size_t>();
+	if (options.count("adaptive-concurrency"))
+	{
+		Http::Server::ConcurrencyLimiterOptions limiter_options;
+		limiter_options.max_queue_size = options["concurrency-queue-size"].as<size_t>();
+		limiter_options.max_wait = std::chrono::milliseconds{options["concurrency-max-wait"].as<unsigned>()};
+		admission_options.adaptive_concurrency = limiter_options;
+	}
+
+	Http::Server::PlacementOptions placement_options;
+	if (options.count("cpu-affinity"))
+	{
+		placement_options.cpus = Http::Server::ParseCpuList(options["cpu-affinity"].as<std::string>());
+	}
+	if (options.count("accept-cpu"))
+	{
+		placement_options.accept_cpu = options["accept-cpu"].as<unsigned>();
+	}
+
+	// Initialise the server.
+	Http::Server::Server s(
+		options["threads"].as<size_t>(),
+		options["address"].as<std::string>(),
+		options["port"].as<std::string>(),
+		pipeline,
+		connection_options,
+		admission_options,
+		listener_options,
+		placement_options);
+
+	// Blocking pool queue is scraped with server metrics.
+	s.GetState().GetMetrics().AddCollector(
+		[&blocking_task_pool]()
+		{
+			return Http::Server::FormatPrometheusMetrics(blocking_task_pool.GetStatistics());
+		});
+
+	// Counters of worker are aggregated by master process.
+	std::optional<Http::Server::CountersPublisher> counters_publisher;
+	if (worker_counters)
+	{
+		counters_publisher.emplace(s.GetState(), *worker_counters, publish_interval);
+	}
+
+	// Run the server until stopped.
+	s.Run();
+	counters_publisher.reset();
+	const auto accept_stats = s.GetAcceptStats();
+	std::cout << "Accepted " << accept_stats.accepted << " connections in " << accept_stats.batches
+		<< " batches, errors " << accept_stats.errors << ", pauses " << accept_stats.pauses
+		<< ", listen overflows " << accept_stats.listen_overflows << std::endl;
+	const auto counters = s.GetState().GetCounters();
+	std::cout << "Requests " << counters.requests << ", rejected " << counters.rejected_requests
+		<< ", received " << counters.bytes_received << " bytes, sent " << counters.bytes_sent
+		<< " bytes, errors: read " << counters.read_errors << ", write " << counters.write_errors
+		<< ", bad request " << counters.bad_requests << ", timeout " << counters.timeouts << std::endl;
+	blocking_task_pool.Stop();
+	if (async_file_reader)
+	{
+		async_file_reader->Stop();
+	}
+	if (tracer)
+	{
+		tracer->Stop();
+		std::cout << "Traced requests: exported " << tracer->ExportedCount()
+			<< ", dropped " << tracer->DroppedCount() << std::endl;
+	}
+
+	const auto statistics = blocking_task_pool.GetStatistics();
+	std::cout << "File system tasks: completed " << statistics.completed_tasks
+		<< ", rejected " << statistics.rejected_tasks
+		<< ", discarded " << statistics.discarded_tasks
+		<< ", average wait " << statistics.average_wait_time.count() << "micros"
+		<< ", max wait " << statistics.max_wait_time.count() << "micros" << std::endl;
+	return 0;
+}
+
+} // namespace
 
 int main(int argc, char* argv[])
 {
+	namespace po = boost::program_options;
+
 	try
 	{
-		// Check command line arguments.
-		if (argc != 5)
+		po::options_description description("Usage: http_server <address> <port> <threads> <doc_root> [options]");
+		description.add_options()
+			("help", "Print help")
+			("address", po::value<std::string>()->required(), "Listen address")
+			("port", po::value<std::string>()->required(), "Listen port")
+			("threads", po::value<size_t>()->required(), "Network threads count")
+			("doc_root", po::value<std::string>()->required(), "Directory with files to serve")
+			("io-threads", po::value<size_t>()->default_value(4), "Threads count for blocking file system work")
+			("io-queue-size", po::value<size_t>()->default_value(1024), "Max file system tasks waiting in queue")
+			("file-io", po::value<std::string>()->default_value("pool"), "File reading mode: pool (blocking pool) or uring (io_uring)")
+			("keep-alive-timeout", po::value<unsigned>()->default_value(60), "Idle seconds before persistent connection is closed, 0 disables timeout")
+			("max-requests", po::value<size_t>()->default_value(1000), "Max requests per connection, 0 means unlimited")
+			("drain-timeout", po::value<unsigned>()->default_value(30), "Max seconds to finish started requests on shutdown")
+			("metrics-path", po::value<std::string>(), "Path answered with server metrics in Prometheus text format, e.g. /metrics")
+			("trace-file", po::value<std::string>(), "File of sampled request spans (JSON per line), enables tracing")
+			("trace-sample-rate", po::value<double>()->default_value(0.01), "Probability of tracing request without traceparent header")
+			("max-connections", po::value<unsigned>()->default_value(10000), "Max open connections, 0 means unlimited")
+			("max-requests-in-flight", po::value<unsigned>()->default_value(4096), "Max requests being handled, 0 means unlimited")
+			("max-buffered-bytes", po::value<size_t>()->default_value(256 * 1024 * 1024), "Max bytes queued for writing, 0 means unlimited")
+			("adaptive-concurrency", "Limit handled requests adaptively by their latency")
+			("concurrency-queue-size", po::value<size_t>()->default_value(256), "Max requests waiting for adaptive concurrency limit, 0 means rejecting them")
+			("concurrency-max-wait", po::value<unsigned>()->default_value(50), "Max milliseconds of waiting for adaptive concurrency limit")
+			("backlog", po::value<int>()->default_value(SOMAXCONN), "Listen backlog")
+			("accept-batch", po::value<size_t>()->default_value(64), "Max connections accepted on one wake up of listener")
+			("accept-balancing", po::value<std::string>()->default_value("round-robin"), "Distribution of connections between network threads: round-robin, least-loaded or incoming-cpu")
+			("cpu-affinity", po::value<std::string>(), "CPUs of network threads like 0-3,8, thread i is pinned to i-th CPU of list")
+			("accept-cpu", po::value<unsigned>(), "CPU of accepting thread")
+			("tcp-nodelay", po::value<bool>()->default_value(true), "Disable Nagle algorithm on accepted sockets")
+			("defer-accept", po::value<unsigned>(), "Seconds to wait for request data before connection is accepted (TCP_DEFER_ACCEPT)")
+			("fast-open", po::value<int>(), "TCP Fast Open queue length")
+			("rcvbuf", po::value<int>(), "Socket receive buffer size")
+			("sndbuf", po::value<int>(), "Socket send buffer size")
+			("quick-ack", "Disable delayed ACK on accepted sockets (TCP_QUICKACK)")
+			("busy-poll", po::value<int>(), "Busy poll microseconds of accepted sockets (SO_BUSY_POLL)")
+			("tcp-keepalive", po::value<std::string>(), "TCP keepalive probes: idle,interval,count in seconds")
+			("handoff-socket", po::value<std::string>(), "Unix socket path for hot restart, new server takes listener of running one")
+			("workers", po::value<size_t>()->default_value(0), "Worker processes started by master process, 0 means single process")
+			("reuse-port", "Every worker process has own listener (SO_REUSEPORT)");
+
+		po::positional_options_description positional;
+		positional.add("address", 1).add("port", 1).add("threads", 1).add("doc_root", 1);
+
+		po::variables_map options;
+		po::store(po::command_line_parser(argc, argv).options(description).positional(positional).run(), options);
+		if (options.count("help"))
+		{
+			std::cout << description << std::endl;
+			return 0;
+		}
+		po::notify(options);
+
+		const auto listener_options = MakeListenerOptions(options);
+		const auto workers = options["workers"].as<size_t>();
+		if (workers == 0)
 		{
-			std::cerr << "Usage: http_server <address> <port> <threads> <doc_root>\n";
-			return 1;
+			return RunServer(options, listener_options, nullptr, {});
 		}
-		Http::Server::RequestHandler request_handler(argv[4]);
-
-		// Initialise the server.
-		Http::Server::Server s(
-			std::stoul(argv[3]),
-			argv[1],
-			argv[2],
-			[&request_handler]
-			(Http::Server::HttpRequestConnectionUPtr http_request)
+
+		// Workers are forked before any thread is started.
+		Http::Server::PreforkOptions prefork_options;
+		prefork_options.workers = workers;
+		prefork_options.reuse_port = options.count("reuse-port") != 0;
+		Http::Server::PreforkMaster master(
+			prefork_options,
+			options["address"].as<std::string>(),
+			options["port"].as<std::string>(),
+			listener_options);
+		return master.Run(
+			[&options, &listener_options, &prefork_options](const int listener, Http::Server::WorkerCounters& counters)
 			{
-				if (!http_request)
-				{
-					return;
-				}
-				const auto request = http_request->GetRequest();
-				http_request->Send(request_handler.HandleRequest(request));
+				auto worker_listener_options = listener_options;
+				worker_listener_options.listener_fd = listener;
+				// Listeners belong to master, so workers don't hand them off.
+				worker_listener_options.handoff_path.clear();
+				return RunServer(options, worker_listener_options, &counters, prefork_options.publish_interval);
 			});
-
-		// Run the server until stopped.
-		s.Run();
 	}
 	catch (const std::exception& e)
 	{